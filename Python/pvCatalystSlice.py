@@ -0,0 +1,27 @@
+# Catalyst 2 pipeline for SalvusCatalystDriver or a solver using
+# SalvusCatalystAdaptor: slice the wavefield at z = 0.5, and save the
+# slice every 10 steps in datasets/
+from paraview.simple import *
+from paraview import catalyst
+
+# the mesh given by the adaptor on the channel "grid"
+grid = TrivialProducer(registrationName='grid')
+
+slice1 = Slice(registrationName='Slice1', Input=grid)
+slice1.SliceType = 'Plane'
+slice1.SliceType.Origin = [0.0, 0.0, 0.5]
+slice1.SliceType.Normal = [0.0, 0.0, 1.0]
+slice1.Triangulatetheslice = 0
+
+vTPD1 = CreateExtractor('VTPD', slice1, registrationName='VTPD1')
+vTPD1.Trigger = 'TimeStep'
+vTPD1.Trigger.Frequency = 10
+vTPD1.Writer.FileName = 'slice_{timestep:06d}.vtpd'
+
+options = catalyst.Options()
+options.GlobalTrigger = 'TimeStep'
+options.ExtractsOutputDirectory = 'datasets'
+
+def catalyst_execute(info):
+    global grid
+    grid.UpdatePipeline(info.time)
@@ -0,0 +1,132 @@
+#include "SalvusCatalystAdaptor.h"
+
+#include <catalyst.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+static_assert(sizeof(conduit_int64) == sizeof(int64_t), "unexpected conduit_int64");
+static_assert(sizeof(conduit_uint8) == sizeof(uint8_t), "unexpected conduit_uint8");
+
+// vtkDataSetAttributes::HIDDENPOINT, the adaptor does not depend on VTK
+static const uint8_t HiddenPoint = 2;
+
+bool SalvusCatalystAdaptor::Initialize(const std::vector<std::string>& scripts)
+{
+  conduit_cpp::Node node;
+  for(size_t i = 0; i < scripts.size(); i++)
+    node["catalyst/scripts/script" + std::to_string(i)].set_string(scripts[i]);
+  catalyst_status err = catalyst_initialize(conduit_cpp::c_node(&node));
+  if(err != catalyst_status_ok)
+  {
+    std::cerr << "failed to initialize Catalyst: " << err << "\n";
+    return false;
+  }
+  return true;
+}
+
+void SalvusCatalystAdaptor::Set_Coordinates(long numElements, const float* coordinates)
+{
+  this->NumberOfElements = numElements;
+  this->Coordinates.resize(3 * 128 * numElements);
+  this->Ghosts.assign(128 * numElements, 0);
+  for(long e = 0; e < numElements; e++)
+  {
+    float* dest = &this->Coordinates[3 * 128 * e];
+    memcpy(dest, &coordinates[3 * 125 * e], 3 * 125 * sizeof(float));
+    for(int n = 125; n < 128; n++)
+    {
+      memcpy(&dest[3 * n], &dest[3 * 124], 3 * sizeof(float));
+      this->Ghosts[128 * e + n] = HiddenPoint;
+    }
+  }
+}
+
+void SalvusCatalystAdaptor::Set_Mesh(long numElements, const float* coordinates)
+{
+  this->Set_Coordinates(numElements, coordinates);
+  this->Connectivity.resize(8 * 64 * numElements);
+  for(long e = 0; e < numElements; e++)
+    SalvusGLL::Hexahedra<int64_t>(128 * e, &this->Connectivity[8 * 64 * e]);
+}
+
+bool SalvusCatalystAdaptor::Execute(long step, double time, const std::vector<Field>& fields)
+{
+  const conduit_index_t NbNodes = 128 * this->NumberOfElements;
+  conduit_cpp::Node exec;
+  auto state = exec["catalyst/state"];
+  state["timestep"].set(static_cast<conduit_int64>(step));
+  state["time"].set(time);
+
+  auto channel = exec["catalyst/channels/grid"];
+  channel["type"].set("mesh");
+  auto mesh = channel["data"];
+
+  // x, y and z are views of the interleaved coordinates
+  float* coords = this->Coordinates.data();
+  mesh["coordsets/coords/type"].set("explicit");
+  mesh["coordsets/coords/values/x"].set_external(coords, NbNodes, 0, 3 * sizeof(float));
+  mesh["coordsets/coords/values/y"].set_external(coords + 1, NbNodes, 0, 3 * sizeof(float));
+  mesh["coordsets/coords/values/z"].set_external(coords + 2, NbNodes, 0, 3 * sizeof(float));
+
+  mesh["topologies/mesh/type"].set("unstructured");
+  mesh["topologies/mesh/coordset"].set("coords");
+  mesh["topologies/mesh/elements/shape"].set("hex");
+  mesh["topologies/mesh/elements/connectivity"].set_external(
+    reinterpret_cast<conduit_int64*>(this->Connectivity.data()), this->Connectivity.size());
+
+  auto ghosts = mesh["fields/vtkGhostType"];
+  ghosts["association"].set("vertex");
+  ghosts["topology"].set("mesh");
+  ghosts["values"].set_external(reinterpret_cast<conduit_uint8*>(this->Ghosts.data()), NbNodes);
+
+  for(const auto& field : fields)
+  {
+    const int NbComponents = static_cast<int>(field.ComponentNames.size());
+    for(int c = 0; c < NbComponents; c++)
+    {
+      const std::string& name = field.ComponentNames[c];
+      auto values = mesh["fields/" + name];
+      values["association"].set("vertex");
+      values["topology"].set("mesh");
+      values["volume_dependent"].set("false");
+      if(NbComponents == 1)
+      {
+        // the solver's array is already laid out as the nodes
+        values["values"].set_external(const_cast<float*>(field.Values), NbNodes);
+      }
+      else
+      {
+        std::vector<float>& component = this->Components[name];
+        component.resize(NbNodes);
+        for(long e = 0; e < this->NumberOfElements; e++)
+          memcpy(&component[128 * e], &field.Values[128 * (NbComponents * e + c)], 128 * sizeof(float));
+        values["values"].set_external(component.data(), NbNodes);
+      }
+    }
+  }
+
+  catalyst_status err = catalyst_execute(conduit_cpp::c_node(&exec));
+  if(err != catalyst_status_ok)
+  {
+    std::cerr << "failed to execute Catalyst at step " << step << ": " << err << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool SalvusCatalystAdaptor::Finalize()
+{
+  conduit_cpp::Node node;
+  catalyst_status err = catalyst_finalize(conduit_cpp::c_node(&node));
+  if(err != catalyst_status_ok)
+  {
+    std::cerr << "failed to finalize Catalyst: " << err << "\n";
+    return false;
+  }
+  this->Coordinates.clear();
+  this->Connectivity.clear();
+  this->Ghosts.clear();
+  this->Components.clear();
+  return true;
+}
@@ -0,0 +1,81 @@
+/*=========================================================================
+// .NAME SalvusCatalystAdaptor - Catalyst 2 adaptor for the Salvus wavefields
+// .SECTION Description
+// Passes the solver's mesh and fields to Catalyst as a Conduit mesh
+// blueprint, without going through HDF5. The layouts are the ones of the
+// Salvus files read by vtkSalvusHDF5Reader:
+//   coordinates  {nElem, 125, 3} float, the GLL nodes of every element
+//   connectivity {nElem * cellsPerElement, 8}, the 8-node hexahedra,
+//                node n of element e being numbered 125 * e + n
+//   fields       {nElem, nComponents, 128} float, padded to 128 per element
+//
+// The mesh is given to Catalyst with 128 nodes per element, so that fields
+// of one component are passed without copy. The static coordinates and
+// connectivity are converted once to this numbering. The 3 padding nodes
+// of every element repeat its last node, are used by no cell, and are
+// marked as hidden points in a vtkGhostType field, so that the padding
+// values are left out of the data ranges. The components of fields with
+// several components are copied to compact buffers at every step.
+//
+// Exposing each component as a view of the solver's array shifted by
+// 128 * c avoids the copy, but needs 128 * nComp points per element: every
+// component then carries the values of the other components at the unused
+// points, the coordinates take 6 times more memory for the stress, and the
+// filters process 6 times more points. With a Catalyst implementation
+// which does nothing, SalvusCatalystDriver -n 32 (32768 elements, 6 stress
+// components) measures Execute() at about 40 ms per step with the copy,
+// against 0.02 ms with the shifted views or with one component.
+*/
+#ifndef __SalvusCatalystAdaptor_h
+#define __SalvusCatalystAdaptor_h
+
+#include "vtkSalvusGLL.h"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+class SalvusCatalystAdaptor
+{
+public:
+  // a field of the solver, {nElem, ComponentNames.size(), 128}
+  struct Field
+  {
+    std::vector<std::string> ComponentNames;
+    const float* Values;
+  };
+
+  // scripts are Catalyst Python scripts. Returns false if Catalyst failed
+  bool Initialize(const std::vector<std::string>& scripts);
+
+  // copy the static mesh, in the 128 nodes per element numbering
+  template <typename T>
+  void Set_Mesh(long numElements, const float* coordinates, const T* connectivity, long numCells)
+  {
+    this->Set_Coordinates(numElements, coordinates);
+    this->Connectivity.resize(8 * numCells);
+    for(long i = 0; i < 8 * numCells; i++)
+      this->Connectivity[i] = (connectivity[i] / 125) * 128 + connectivity[i] % 125;
+  }
+
+  // same, the cells being the 64 hexahedra of the GLL lattice of every element
+  void Set_Mesh(long numElements, const float* coordinates);
+
+  // run the Catalyst pipelines. The field values are only used during the call
+  bool Execute(long step, double time, const std::vector<Field>& fields);
+
+  bool Finalize();
+
+private:
+  void Set_Coordinates(long numElements, const float* coordinates);
+
+  long NumberOfElements = 0;
+  std::vector<float> Coordinates;
+  std::vector<int64_t> Connectivity;
+  std::vector<uint8_t> Ghosts; // the padding nodes are hidden
+  std::map<std::string, std::vector<float>> Components; // copies of the components
+};
+
+#endif
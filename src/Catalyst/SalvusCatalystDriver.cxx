@@ -0,0 +1,118 @@
+// SalvusCatalystDriver: mimics the output loop of the Salvus solver, to
+// measure the cost of the in-situ pipelines without running the solver.
+//
+// A cube of n x n x n order 4 elements is split in 64 hexahedra each, with
+// the layouts of the Salvus files. At every step, a plane wave is written
+// in the 128-padded fields, and SalvusCatalystAdaptor::Execute() is timed.
+//
+// The Catalyst implementation is chosen at run time, e.g. for ParaView:
+//   CATALYST_IMPLEMENTATION_NAME=paraview
+//   CATALYST_IMPLEMENTATION_PATHS=<ParaView>/lib/catalyst
+//   SalvusCatalystDriver -n 16 -steps 100 -script pipeline.py
+
+#include "SalvusCatalystAdaptor.h"
+#include "vtkSalvusGLL.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+using std::cerr;
+
+int main(int argc, char** argv)
+{
+  int n = 16;
+  int NbSteps = 100;
+  bool acoustic = false;
+  std::vector<std::string> scripts;
+
+  for(int a = 1; a < argc; a++)
+  {
+    std::string arg = argv[a];
+    if(arg == "-n" && a + 1 < argc)
+      n = std::max(1, atoi(argv[++a]));
+    else if(arg == "-steps" && a + 1 < argc)
+      NbSteps = std::max(1, atoi(argv[++a]));
+    else if(arg == "-script" && a + 1 < argc)
+      scripts.push_back(argv[++a]);
+    else if(arg == "-acoustic")
+      acoustic = true;
+    else
+    {
+      cerr << "\nSalvusCatalystDriver: benchmark of the Salvus Catalyst adaptor\n"
+           << "options are:\n"
+           << "  -n <int>         (number of elements along each axis, default 16)\n"
+           << "  -steps <int>     (number of output steps, default 100)\n"
+           << "  -script <file>   (Catalyst Python script, may be repeated)\n"
+           << "  -acoustic        (output phi_tt instead of the 6 stress components)\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  const long NbElements = static_cast<long>(n) * n * n;
+  const long NbCells = 64 * NbElements;
+  std::vector<float> coords(375 * NbElements);
+  long e = 0;
+  for(int ez = 0; ez < n; ez++)
+    for(int ey = 0; ey < n; ey++)
+      for(int ex = 0; ex < n; ex++, e++)
+      {
+        for(int k = 0; k < 5; k++)
+          for(int j = 0; j < 5; j++)
+            for(int i = 0; i < 5; i++)
+            {
+              float* p = &coords[375 * e + 3 * (i + 5 * j + 25 * k)];
+              p[0] = ex + 0.5 * (SalvusGLL::Points[i] + 1.0);
+              p[1] = ey + 0.5 * (SalvusGLL::Points[j] + 1.0);
+              p[2] = ez + 0.5 * (SalvusGLL::Points[k] + 1.0);
+            }
+      }
+
+  SalvusCatalystAdaptor::Field field;
+  if(acoustic)
+    field.ComponentNames = {"phi_tt"};
+  else
+    field.ComponentNames = {"stress_xx", "stress_yy", "stress_zz", "stress_yz", "stress_xz", "stress_xy"};
+  const int NbComponents = static_cast<int>(field.ComponentNames.size());
+  std::vector<float> values(128 * NbComponents * NbElements, 0.0f);
+  field.Values = values.data();
+
+  SalvusCatalystAdaptor adaptor;
+  if(!adaptor.Initialize(scripts))
+    return EXIT_FAILURE;
+  auto t0 = std::chrono::steady_clock::now();
+  adaptor.Set_Mesh(NbElements, coords.data());
+  double meshTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  cerr << NbElements << " elements, " << NbCells << " hexahedra, " << NbComponents
+       << " component(s), mesh copied in " << meshTime << " s\n";
+
+  const double dt = 0.1;
+  double total = 0.0, fastest = 1e300, slowest = 0.0;
+  for(int step = 0; step < NbSteps; step++)
+  {
+    // the solver's part: a plane wave along x
+    const double time = step * dt;
+    for(long el = 0; el < NbElements; el++)
+      for(int c = 0; c < NbComponents; c++)
+        for(int node = 0; node < 125; node++)
+          values[128 * (NbComponents * el + c) + node] =
+            (c + 1) * std::sin(coords[375 * el + 3 * node] - 2.0 * time);
+
+    auto start = std::chrono::steady_clock::now();
+    if(!adaptor.Execute(step, time, {field}))
+      return EXIT_FAILURE;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    total += elapsed;
+    fastest = std::min(fastest, elapsed);
+    slowest = std::max(slowest, elapsed);
+  }
+  adaptor.Finalize();
+
+  cerr << "Execute: " << total / NbSteps << " s per step (min " << fastest << ", max " << slowest
+       << "), " << 125.0 * NbElements * NbComponents * NbSteps / total << " values per second\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/*=========================================================================
+// .NAME vtkSalvusGLL - GLL basis of the order 4 Salvus spectral elements
+// .SECTION Description
+// Lagrange polynomials on the 5 Gauss-Lobatto-Legendre points of [-1, 1].
+// The 125 nodes of an element form a tensor-product lattice, node
+// i + 5*j + 25*k being at reference coordinates (x_i, x_j, x_k).
+*/
+#ifndef __vtkSalvusGLL_h
+#define __vtkSalvusGLL_h
+
+#include <algorithm>
+#include <cmath>
+
+namespace SalvusGLL
+{
+// the GLL points of order 4: -1, -sqrt(3/7), 0, sqrt(3/7), 1
+static const double Points[5] = {-1.0, -0.65465367070797714, 0.0, 0.65465367070797714, 1.0};
+
+// values of the 5 Lagrange polynomials at x
+inline void Lagrange(double x, double l[5])
+{
+  for(int a = 0; a < 5; a++)
+  {
+    l[a] = 1.0;
+    for(int m = 0; m < 5; m++)
+      if(m != a)
+        l[a] *= (x - Points[m]) / (Points[a] - Points[m]);
+  }
+}
+
+// derivatives of the 5 Lagrange polynomials at x
+inline void LagrangeDerivative(double x, double dl[5])
+{
+  for(int a = 0; a < 5; a++)
+  {
+    dl[a] = 0.0;
+    for(int m = 0; m < 5; m++)
+    {
+      if(m == a)
+        continue;
+      double term = 1.0 / (Points[a] - Points[m]);
+      for(int q = 0; q < 5; q++)
+        if(q != a && q != m)
+          term *= (x - Points[q]) / (Points[a] - Points[q]);
+      dl[a] += term;
+    }
+  }
+}
+
+// values and reference derivatives of the 125 shape functions at xi
+inline void ShapeFunctions(const double xi[3], double N[125], double dN[125][3])
+{
+  double l[3][5], dl[3][5];
+  for(int d = 0; d < 3; d++)
+  {
+    Lagrange(xi[d], l[d]);
+    LagrangeDerivative(xi[d], dl[d]);
+  }
+  for(int k = 0; k < 5; k++)
+    for(int j = 0; j < 5; j++)
+      for(int i = 0; i < 5; i++)
+      {
+        const int n = i + 5 * j + 25 * k;
+        N[n] = l[0][i] * l[1][j] * l[2][k];
+        dN[n][0] = dl[0][i] * l[1][j] * l[2][k];
+        dN[n][1] = l[0][i] * dl[1][j] * l[2][k];
+        dN[n][2] = l[0][i] * l[1][j] * dl[2][k];
+      }
+}
+
+// inverse of a 3x3 matrix. Returns its determinant, inv is not set if 0
+inline double Invert3x3(const double J[3][3], double inv[3][3])
+{
+  const double c00 = J[1][1] * J[2][2] - J[1][2] * J[2][1];
+  const double c01 = J[1][2] * J[2][0] - J[1][0] * J[2][2];
+  const double c02 = J[1][0] * J[2][1] - J[1][1] * J[2][0];
+  const double det = J[0][0] * c00 + J[0][1] * c01 + J[0][2] * c02;
+  if(det == 0.0)
+    return det;
+  inv[0][0] = c00 / det;
+  inv[1][0] = c01 / det;
+  inv[2][0] = c02 / det;
+  inv[0][1] = (J[0][2] * J[2][1] - J[0][1] * J[2][2]) / det;
+  inv[1][1] = (J[0][0] * J[2][2] - J[0][2] * J[2][0]) / det;
+  inv[2][1] = (J[0][1] * J[2][0] - J[0][0] * J[2][1]) / det;
+  inv[0][2] = (J[0][1] * J[1][2] - J[0][2] * J[1][1]) / det;
+  inv[1][2] = (J[0][2] * J[1][0] - J[0][0] * J[1][2]) / det;
+  inv[2][2] = (J[0][0] * J[1][1] - J[0][1] * J[1][0]) / det;
+  return det;
+}
+
+// find the reference coordinates xi of point p in the element whose 125
+// nodes are coords (x, y, z interleaved), by Newton iterations.
+// Returns true if p is inside the element.
+inline bool FindReferenceCoordinates(const float* coords, const double p[3], double xi[3])
+{
+  double N[125], dN[125][3];
+  xi[0] = xi[1] = xi[2] = 0.0;
+  for(int iter = 0; iter < 20; iter++)
+  {
+    ShapeFunctions(xi, N, dN);
+    double r[3] = {p[0], p[1], p[2]};
+    double J[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+    for(int n = 0; n < 125; n++)
+      for(int d = 0; d < 3; d++)
+      {
+        r[d] -= N[n] * coords[3 * n + d];
+        for(int e = 0; e < 3; e++)
+          J[d][e] += dN[n][e] * coords[3 * n + d];
+      }
+    double inv[3][3];
+    if(Invert3x3(J, inv) == 0.0)
+      return false;
+    double step = 0.0;
+    for(int d = 0; d < 3; d++)
+    {
+      const double dxi = inv[d][0] * r[0] + inv[d][1] * r[1] + inv[d][2] * r[2];
+      xi[d] += dxi;
+      step = std::max(step, std::abs(dxi));
+      // far outside, the polynomial map is meaningless
+      if(std::abs(xi[d]) > 3.0)
+        return false;
+    }
+    if(step < 1.0e-10)
+      break;
+  }
+  for(int d = 0; d < 3; d++)
+    if(std::abs(xi[d]) > 1.0 + 1.0e-6)
+      return false;
+  return true;
+}
+
+// the 8 corners of a hexahedron of the lattice, in the VTK order, as
+// offsets (i, j, k) from its first node
+static const int HexCorners[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                                     {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+
+// the 64 hexahedra {64, 8} between the nodes of the lattice of an element,
+// node i + 5*j + 25*k of the element being numbered first + i + 5*j + 25*k
+template <typename T>
+inline void Hexahedra(T first, T* cells)
+{
+  for(int k = 0; k < 4; k++)
+    for(int j = 0; j < 4; j++)
+      for(int i = 0; i < 4; i++, cells += 8)
+        for(int c = 0; c < 8; c++)
+          cells[c] = first + (i + HexCorners[c][0]) + 5 * (j + HexCorners[c][1]) + 25 * (k + HexCorners[c][2]);
+}
+} // namespace SalvusGLL
+
+#endif
@@ -2,10 +2,15 @@
 
 #include "vtkSalvusHDF5Reader.h"
 
+#include "vtkAppendPolyData.h"
 #include "vtkCellArray.h"
 #include "vtkCellData.h"
+#include "vtkContourFilter.h"
+#include "vtkCutter.h"
+#include "vtkDataArray.h"
 #include "vtkDataArraySelection.h"
 #include "vtkDataSetAttributes.h"
+#include "vtkDoubleArray.h"
 #include "vtkErrorCode.h"
 #include "vtkFieldData.h"
 #include "vtkFloatArray.h"
@@ -13,16 +18,31 @@
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
 #include "vtkIntArray.h"
+#include "vtkMath.h"
+#include "vtkMultiProcessController.h"
+#include "vtkNew.h"
 #include "vtkObjectFactory.h"
+#include "vtkPlane.h"
 #include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkSMPTools.h"
+#include "vtkSmartPointer.h"
+#include "vtkSalvusGLL.h"
+#include "vtkSalvusVizLayout.h"
 #include "vtkStreamingDemandDrivenPipeline.h"
+#include "vtkTable.h"
 #include "vtkUnstructuredGrid.h"
 
 #include <sys/time.h>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
 #include <vector>
 #include <string>
 #include <hdf5.h>
+#include <vtksys/SystemTools.hxx>
 using namespace std;
 
 #include "vtkMPICommunicator.h"
@@ -34,6 +54,71 @@ hid_t    file_id;
 
 vtkStandardNewMacro(vtkSalvusHDF5Reader);
 
+struct vtkSalvusHDF5Reader::vtkSalvusSharedGeometry
+{
+  struct Retired_Window
+  {
+    MPI_Comm NodeComm;
+    MPI_Win Window;
+    std::vector<vtkSmartPointer<vtkDataArray>> Views;
+  };
+
+  MPI_Comm NodeComm = MPI_COMM_NULL;
+  MPI_Win Window = MPI_WIN_NULL;
+  std::string Source; // file, model and elements of this process
+  vtkSmartPointer<vtkPoints> Points;
+  vtkSmartPointer<vtkCellArray> Cells;
+  std::vector<vtkSmartPointer<vtkDataArray>> Views; // the arrays wrapping the window
+  // windows of the previous layouts, which downstream datasets may still use
+  std::vector<Retired_Window> Retired;
+
+  // keep the current window until its views are released
+  void Retire()
+  {
+    if(this->Window != MPI_WIN_NULL)
+      this->Retired.push_back({this->NodeComm, this->Window, this->Views});
+    this->NodeComm = MPI_COMM_NULL;
+    this->Window = MPI_WIN_NULL;
+    this->Points = nullptr;
+    this->Cells = nullptr;
+    this->Views.clear();
+    this->Source.clear();
+  }
+
+  // free the retired windows whose views are only held here on every
+  // process, or all of them. Collective on world, every process retiring
+  // the same windows.
+  void Free_Retired(MPI_Comm world, bool all)
+  {
+    const int n = static_cast<int>(this->Retired.size());
+    if(n == 0)
+      return;
+    std::vector<int> unused(n, 1), allUnused(n, 1);
+    if(!all)
+    {
+      for(int i = 0; i < n; i++)
+        for(const auto& view : this->Retired[i].Views)
+          if(view->GetReferenceCount() > 1)
+            unused[i] = 0;
+      MPI_Allreduce(unused.data(), allUnused.data(), n, MPI_INT, MPI_MIN, world);
+    }
+    std::vector<Retired_Window> kept;
+    for(int i = 0; i < n; i++)
+    {
+      Retired_Window& retired = this->Retired[i];
+      if(!allUnused[i])
+      {
+        kept.push_back(retired);
+        continue;
+      }
+      retired.Views.clear();
+      MPI_Win_free(&retired.Window);
+      MPI_Comm_free(&retired.NodeComm);
+    }
+    this->Retired.swap(kept);
+  }
+};
+
 int vtkSalvusHDF5Reader::CanReadFile(const char* fname )
 {
   int ret = 0;
@@ -62,6 +147,26 @@ vtkSalvusHDF5Reader::vtkSalvusHDF5Reader()
   this->TimeStep = 0;
   this->ActualTimeStep = 0;
   this->TimeStepTolerance = 1E-6;
+  this->OutputMode = VOLUME_MODE;
+  this->BatchSize = 16384;
+  this->CellsPerElement = 64;
+  this->SliceOrigin[0] = this->SliceOrigin[1] = this->SliceOrigin[2] = 0.0;
+  this->SliceNormal[0] = this->SliceNormal[1] = 0.0;
+  this->SliceNormal[2] = 1.0;
+  this->UseElementRanges = 0;
+  this->ValueRangeFilter = 0;
+  this->ComputeGradients = 0;
+  this->UseSharedMemoryGeometry = 0;
+  this->SharedGeometry = new vtkSalvusSharedGeometry;
+  this->ValueRange[0] = 0.0;
+  this->ValueRange[1] = 1.0;
+  this->ContourArrayRange[0] = this->ContourArrayGlobalRange[0] = VTK_DOUBLE_MAX;
+  this->ContourArrayRange[1] = this->ContourArrayGlobalRange[1] = VTK_DOUBLE_MIN;
+  this->RangeCacheFileName = nullptr;
+  this->ContourArray = nullptr;
+  this->ElementRangesAvailable = false;
+  this->VizLayout = false;
+  this->GLLNodeOrdering = true;
   
   this->varnames[0] = {"stress_xx", "stress_yy", "stress_zz", "stress_yz", "stress_xz", "stress_xy"};
   this->varnames[1] = {"phi_tt"};
@@ -72,10 +177,72 @@ vtkSalvusHDF5Reader::~vtkSalvusHDF5Reader()
   vtkDebugMacro(<< "cleaning up inside destructor");
   if (this->FileName)
     delete [] this->FileName;
+  if (this->RangeCacheFileName)
+    delete [] this->RangeCacheFileName;
+  if (this->ContourArray)
+    delete [] this->ContourArray;
   this->ELASTIC_PointDataArraySelection->Delete();
   this->ELASTIC_PointDataArraySelection = nullptr;
   this->ACOUSTIC_PointDataArraySelection->Delete();
   this->ACOUSTIC_PointDataArraySelection = nullptr;
+  this->Release_Shared_Geometry();
+  delete this->SharedGeometry;
+}
+
+vtkTypeBool vtkSalvusHDF5Reader::ProcessRequest(vtkInformation* request,
+                                                vtkInformationVector** inputVector,
+                                                vtkInformationVector* outputVector)
+{
+  // the type of the output depends on this->OutputMode
+  if (request->Has(vtkDemandDrivenPipeline::REQUEST_DATA_OBJECT()))
+  {
+    return this->RequestDataObject(request, inputVector, outputVector);
+  }
+  return this->Superclass::ProcessRequest(request, inputVector, outputVector);
+}
+
+int vtkSalvusHDF5Reader::FillOutputPortInformation(int vtkNotUsed(port), vtkInformation* info)
+{
+  info->Set(vtkDataObject::DATA_TYPE_NAME(), "vtkDataObject");
+  return 1;
+}
+
+int vtkSalvusHDF5Reader::RequestDataObject(
+                         vtkInformation *vtkNotUsed(request),
+                         vtkInformationVector **vtkNotUsed(inputVector),
+                         vtkInformationVector* outputVector)
+{
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  vtkDataObject* output = outInfo->Get(vtkDataObject::DATA_OBJECT());
+
+  if(this->OutputMode == VOLUME_MODE)
+  {
+    if(!vtkUnstructuredGrid::SafeDownCast(output))
+    {
+      vtkUnstructuredGrid* newOutput = vtkUnstructuredGrid::New();
+      outInfo->Set(vtkDataObject::DATA_OBJECT(), newOutput);
+      newOutput->FastDelete();
+    }
+  }
+  else if(this->OutputMode == PROBE_MODE)
+  {
+    if(!vtkTable::SafeDownCast(output))
+    {
+      vtkTable* newOutput = vtkTable::New();
+      outInfo->Set(vtkDataObject::DATA_OBJECT(), newOutput);
+      newOutput->FastDelete();
+    }
+  }
+  else
+  {
+    if(!vtkPolyData::SafeDownCast(output))
+    {
+      vtkPolyData* newOutput = vtkPolyData::New();
+      outInfo->Set(vtkDataObject::DATA_OBJECT(), newOutput);
+      newOutput->FastDelete();
+    }
+  }
+  return 1;
 }
 
 int vtkSalvusHDF5Reader::RequestInformation(
@@ -95,6 +262,8 @@ int vtkSalvusHDF5Reader::RequestInformation(
   outInfo->Set(vtkDataObject::DATA_NUMBER_OF_GHOST_LEVELS(), 0);
 
   root_id = H5Gopen(file_id, "/", H5P_DEFAULT);
+  // files written by SalvusVizConverter
+  this->VizLayout = H5Aexists(root_id, SalvusVizLayout::Attribute) > 0;
 
   if(this->ModelName == 0)
   {
@@ -110,13 +279,24 @@ int vtkSalvusHDF5Reader::RequestInformation(
   H5Sget_simple_extent_dims(filespace0, dimsf, NULL);
   this->NbCells = dimsf[0];
   H5Sclose(filespace0);
-  H5Dclose(mesh_id);
 
   filespace1 = H5Dget_space(coords_id);
   H5Sget_simple_extent_dims(filespace1, dimsf, NULL);
-  this->NbNodes = dimsf[0] * dimsf[1];
+  // {nElem, 125, 3}, or {nNodes, 3} once converted
+  this->NbNodes = this->VizLayout ? dimsf[0] : dimsf[0] * dimsf[1];
   H5Sclose(filespace1);
   H5Dclose(coords_id);
+  // each spectral element of 125 GLL nodes is split in 64 hexahedra
+  if(dimsf[0] > 0 && !this->VizLayout)
+    this->CellsPerElement = this->NbCells / dimsf[0];
+
+  // the gradients, the probes and the surface mode use the GLL basis
+  this->GLLNodeOrdering = this->VizLayout || this->NbCells == 0 || this->Check_GLL_Node_Ordering(mesh_id);
+  if(!this->GLLNodeOrdering &&
+     (this->ComputeGradients || this->OutputMode == PROBE_MODE || this->OutputMode == SURFACE_MODE))
+    vtkWarningMacro(<< "the nodes of the elements of " << this->FileName
+                    << " are not numbered i + 5*j + 25*k, the gradients, the probes and the surface mode are disabled");
+  H5Dclose(mesh_id);
 
   int MeshSizes[2] = {this->NbNodes, this->NbCells};
   if(H5Lexists(root_id, "volume", H5P_DEFAULT))
@@ -134,7 +314,17 @@ int vtkSalvusHDF5Reader::RequestInformation(
       status = H5Aread(attr1, H5T_NATIVE_DOUBLE, &t_start);
       status = H5Aclose(attr1);
 
-      if(H5Lexists(volume_id, "stress", H5P_DEFAULT))
+      if(this->VizLayout)
+      {
+        const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+        hid_t var_id = H5Dopen(root_id, SalvusVizLayout::Field(model, this->varnames[this->ModelName][0].c_str()).c_str(), H5P_DEFAULT);
+        filespace0 = H5Dget_space(var_id);
+        H5Sget_simple_extent_dims(filespace0, dimsf, NULL);
+        H5Sclose(filespace0);
+        this->NumberOfTimeSteps = dimsf[0];
+        H5Dclose(var_id);
+      }
+      else if(H5Lexists(volume_id, "stress", H5P_DEFAULT))
       {
         hid_t stress_id = H5Dopen(volume_id, "stress", H5P_DEFAULT);
         filespace0 = H5Dget_space(stress_id);
@@ -172,8 +362,43 @@ int vtkSalvusHDF5Reader::RequestInformation(
     H5Gclose(volume_id);
     }
 
+  // the time series cover all time steps, the output does not depend on time
+  if(this->OutputMode == PROBE_MODE)
+  {
+    outInfo->Remove(vtkStreamingDemandDrivenPipeline::TIME_RANGE());
+    outInfo->Remove(vtkStreamingDemandDrivenPipeline::TIME_STEPS());
+  }
+
   H5Gclose(root_id);
   H5Fclose(file_id);
+
+  if(this->OutputMode == SURFACE_MODE && !this->VizLayout && this->GLLNodeOrdering)
+    this->Update_Boundary_Cache();
+
+  // publish the data ranges found in the range cache, without reading any field data
+  outInfo->Remove(vtkDataObject::POINT_DATA_VECTOR());
+  if(this->Update_Range_Cache())
+  {
+    vtkInformationVector* fieldsInfo = vtkInformationVector::New();
+    for(const auto& varn : this->varnames[this->ModelName])
+    {
+      double range[2];
+      if(this->GetPointArrayRange(varn.c_str(), -1, range))
+      {
+        vtkInformation* fieldInfo = vtkInformation::New();
+        fieldInfo->Set(vtkDataObject::FIELD_ASSOCIATION(), vtkDataObject::FIELD_ASSOCIATION_POINTS);
+        fieldInfo->Set(vtkDataObject::FIELD_NAME(), varn.c_str());
+        fieldInfo->Set(vtkDataObject::FIELD_ARRAY_TYPE(), VTK_FLOAT);
+        fieldInfo->Set(vtkDataObject::FIELD_NUMBER_OF_COMPONENTS(), 1);
+        fieldInfo->Set(vtkDataObject::FIELD_RANGE(), range, 2);
+        fieldsInfo->Append(fieldInfo);
+        fieldInfo->FastDelete();
+      }
+    }
+    outInfo->Set(vtkDataObject::POINT_DATA_VECTOR(), fieldsInfo);
+    fieldsInfo->FastDelete();
+  }
+  this->Update_Contour_Array_Ranges();
   return 1;
 }
 
@@ -191,7 +416,6 @@ int vtkSalvusHDF5Reader::RequestData(
   vtkDebugMacro( << "RequestData(BEGIN)");
   vtkInformation* outInfo = outputVector->GetInformationObject(0);
   vtkDataObject* doOutput = outInfo->Get(vtkDataObject::DATA_OBJECT());
-  vtkUnstructuredGrid* output = vtkUnstructuredGrid::SafeDownCast(doOutput);
 
   int piece = outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_PIECE_NUMBER());
   int numPieces = outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_NUMBER_OF_PIECES());
@@ -224,10 +448,11 @@ int vtkSalvusHDF5Reader::RequestData(
 	break;
       }
     }
-    output->GetInformation()->Set(vtkDataObject::DATA_TIME_STEP(), requestedTimeValue);
+    doOutput->GetInformation()->Set(vtkDataObject::DATA_TIME_STEP(), requestedTimeValue);
   }
   cout << "requestedTimeValue "  << requestedTimeValue << endl;
   cout << "this->ActualTimeStep "  << this->ActualTimeStep << endl;
+  this->Update_Contour_Array_Ranges();
 
   vtkDebugMacro(<< "getting piece " << piece << " out of " << numPieces << " pieces");
   if (!this->FileName)
@@ -235,6 +460,42 @@ int vtkSalvusHDF5Reader::RequestData(
     vtkErrorMacro(<< "error reading header specified!");
     return 0;
   }
+
+  if(this->VizLayout)
+  {
+#ifdef PARALLEL_DEBUG
+    errs.close();
+#endif
+    if(this->OutputMode != VOLUME_MODE)
+    {
+      vtkErrorMacro(<< this->FileName << " was written by SalvusVizConverter, only the Volume output mode can read it");
+      return 0;
+    }
+    return this->Read_Viz_Layout(vtkUnstructuredGrid::SafeDownCast(doOutput), piece, numPieces);
+  }
+  // the output stays empty, RequestInformation warned
+  if(!this->GLLNodeOrdering && (this->OutputMode == PROBE_MODE || this->OutputMode == SURFACE_MODE))
+  {
+#ifdef PARALLEL_DEBUG
+    errs.close();
+#endif
+    return 1;
+  }
+  if(this->OutputMode == PROBE_MODE)
+  {
+#ifdef PARALLEL_DEBUG
+    errs.close();
+#endif
+    return this->Extract_Probes(vtkTable::SafeDownCast(doOutput), piece);
+  }
+  if(this->OutputMode != VOLUME_MODE)
+  {
+#ifdef PARALLEL_DEBUG
+    errs.close();
+#endif
+    return this->Extract_Streamed(vtkPolyData::SafeDownCast(doOutput), piece, numPieces);
+  }
+  vtkUnstructuredGrid* output = vtkUnstructuredGrid::SafeDownCast(doOutput);
   size_t size;
 
   file_id = H5Fopen(this->FileName, H5F_ACC_RDONLY, H5P_DEFAULT);
@@ -256,6 +517,60 @@ int vtkSalvusHDF5Reader::RequestData(
   errs <<"this->NbNodes = " << this->NbNodes << ", this->NbCells = " << this->NbCells << std::endl;
 #endif
 
+  // with the value range filter, only the elements which may contain the
+  // requested values are read, the pieces being made of whole elements
+  if(this->ValueRangeFilter && this->ElementRangesAvailable)
+  {
+    long MyFirst_Element, MyNumber_of_Elements;
+    ElementRuns runs;
+    this->Get_Piece_Elements(piece, numPieces, MyFirst_Element, MyNumber_of_Elements);
+    this->Select_Elements(MyFirst_Element, MyNumber_of_Elements, runs);
+    output->ShallowCopy(this->Read_Element_Runs(mesh_id, coords_id, data_id, runs));
+#ifdef PARALLEL_DEBUG
+    errs << "kept " << output->GetNumberOfCells() / this->CellsPerElement << " elements out of " << MyNumber_of_Elements << endl;
+    errs.close();
+#endif
+    H5Dclose(data_id);
+    H5Dclose(coords_id);
+    H5Dclose(mesh_id);
+    H5Gclose(volume_id);
+    H5Gclose(root_id);
+    H5Fclose(file_id);
+    this->UpdateProgress(1.0);
+    return 1;
+  }
+
+  // the geometry is shared by the processes of a node, and kept across time steps
+  // every process must take part, one piece per process
+  vtkMultiProcessController* controller = vtkMultiProcessController::GetGlobalController();
+  if(this->UseSharedMemoryGeometry && numPieces > 1 && controller &&
+     numPieces == controller->GetNumberOfProcesses() && piece == controller->GetLocalProcessId())
+  {
+    long MyFirst_Element, MyNumber_of_Elements;
+    this->Get_Piece_Elements(piece, numPieces, MyFirst_Element, MyNumber_of_Elements);
+    if(this->Load_Shared_Geometry(output, mesh_id, coords_id, MyFirst_Element, MyNumber_of_Elements))
+    {
+      this->UpdateProgress(0.70);
+      this->Load_Variables(output, numPieces, MyNumber_of_Elements * 125, MyFirst_Element * 125, data_id);
+      if(this->ComputeGradients)
+        this->Compute_Gradients(output->GetPointData(),
+                                vtkFloatArray::SafeDownCast(output->GetPoints()->GetData())->GetPointer(0),
+                                MyNumber_of_Elements);
+#ifdef PARALLEL_DEBUG
+      errs << "shared geometry of " << MyNumber_of_Elements << " elements\n";
+      errs.close();
+#endif
+      H5Dclose(data_id);
+      H5Dclose(coords_id);
+      H5Dclose(mesh_id);
+      H5Gclose(volume_id);
+      H5Gclose(root_id);
+      H5Fclose(file_id);
+      this->UpdateProgress(1.0);
+      return 1;
+    }
+  }
+
 // here we allocate the final list necessary for VTK. It includes an extra
 // integer for every hexahedra to say that the next cell contains 8 nodes.
 // to avoid allocating two lists and making transfers from one to the other
@@ -275,7 +590,8 @@ int vtkSalvusHDF5Reader::RequestData(
   }
   else
   {
-    load = this->NbCells / numPieces;
+    // pieces are made of whole elements, so that derivatives can be computed with the GLL basis
+    load = (this->NbCells / this->CellsPerElement / numPieces) * this->CellsPerElement;
     if (piece < (numPieces-1))
     {
       MyNumber_of_Cells = load;
@@ -410,53 +726,37 @@ int vtkSalvusHDF5Reader::RequestData(
   cells->FastDelete();
   delete [] types;
   this->UpdateProgress(0.50);
-  float *coords0 = nullptr;
   vtkFloatArray *coords = vtkFloatArray::New(); // destination array
   coords->SetNumberOfComponents(3);
   coords->SetNumberOfTuples(MyNumber_of_Nodes);
-  if(numPieces > 1)
-  {
-    coords0 = new float[3 * this->NbNodes]; // temporary storage for the *full* list
-  }
 #ifdef PARALLEL_DEBUG
   errs << __LINE__ << ": allocating " << MyNumber_of_Nodes  << " coordinates of size " <<  3*sizeof(float) << " bytes = " << MyNumber_of_Nodes * 3 *sizeof(float) << " bytes\n";
 #endif
 
-  count[0] = this->NbNodes;
+  count[0] = MyNumber_of_Nodes;
   count[1] = 3;
   memspace = H5Screate_simple(2, count, NULL);
 
   offset[0] = 0;
   offset[1] = 0;
-  count[0] = this->NbNodes;
+  count[0] = MyNumber_of_Nodes;
   count[1] = 3;
   H5Sselect_hyperslab (memspace, H5S_SELECT_SET, offset, NULL, count, NULL);
 
-  count[0] = this->NbNodes/125;
+  // pieces are made of whole elements, only their slice of the table is read
+  count[0] = MyNumber_of_Nodes/125;
   count[1] = 125;
   count[2] = 3;
-  offset[0] = 0;
+  offset[0] = minId/125;
   offset[1] = 0;
   offset[2] = 0;
 
   dataspace = H5Dget_space(coords_id);
   H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
 
-  if(numPieces == 1)
-    {
-    status = H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT,
+  status = H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT,
             static_cast<vtkFloatArray *>(coords)->GetPointer(0));
-    }
-  else
-    {
-    status = H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, coords0);
-
-    // void *memcpy(void *dest, const void *src, size_t n);
-    memcpy(static_cast<vtkFloatArray *>(coords)->GetPointer(0),
-           &coords0[minId*3], 
-           sizeof(float) * 3 * MyNumber_of_Nodes);
-    delete [] coords0;
-    }
+  H5Sclose(dataspace);
   H5Dclose(coords_id);
   H5Sclose(memspace);
   vtkPoints *points = vtkPoints::New();
@@ -469,6 +769,8 @@ int vtkSalvusHDF5Reader::RequestData(
 
   // following code will read either ELASTIC or ACOUSTIC data depending on how variable this->ModelName is set
   this->Load_Variables(output, numPieces, MyNumber_of_Nodes, minId, data_id);
+  if(this->ComputeGradients)
+    this->Compute_Gradients(output->GetPointData(), coords->GetPointer(0), MyNumber_of_Nodes / 125);
 
   H5Dclose(data_id);
   H5Gclose(volume_id);
@@ -495,18 +797,15 @@ bool vtkSalvusHDF5Reader::Is_Variable_Enabled(const char* vname)
     return Get_Acoustic_PointArrayStatus(vname);
 }
 
-void vtkSalvusHDF5Reader::Load_Variables(vtkUnstructuredGrid* output, const int numPieces, const int MyNumber_of_Nodes, const int minId, long int dset_id)
+// pieces are made of whole elements, the nodes of a piece are the GLL nodes
+// of elements [minId/125, (minId+MyNumber_of_Nodes)/125), and only this
+// slice of the field is read
+void vtkSalvusHDF5Reader::Load_Variables(vtkUnstructuredGrid* output, const int vtkNotUsed(numPieces), const int MyNumber_of_Nodes, const int minId, long int dset_id)
 {
   hsize_t count[4], offset[4];
   hid_t memspace, dataspace, data_id = static_cast<hid_t >(dset_id);
   herr_t status;
   
-  float *data0 = nullptr;
-  
-  if(numPieces > 1)
-  {
-    data0 = new float[this->NbNodes]; // temporary storage
-  }
   for(int i=0; i < this->varnames[this->ModelName].size(); i++)
   {
     const char *vname = this->varnames[this->ModelName][i].c_str();
@@ -517,48 +816,1768 @@ void vtkSalvusHDF5Reader::Load_Variables(vtkUnstructuredGrid* output, const int
       data->SetNumberOfTuples(MyNumber_of_Nodes);
       data->SetName(vname);
     
-      count[0] = this->NbNodes;
+      count[0] = MyNumber_of_Nodes;
       count[1] = 1;
       memspace = H5Screate_simple(2, count, NULL);
 
       offset[0] = 0;
       offset[1] = 0;
-      count[0] = this->NbNodes;
+      count[0] = MyNumber_of_Nodes;
       count[1] = 1;
       H5Sselect_hyperslab (memspace, H5S_SELECT_SET, offset, NULL, count, NULL);
 
       count[0] = 1; // timestep slice
-      count[1] = this->NbNodes/125;
+      count[1] = MyNumber_of_Nodes/125;
       count[2] = 1;
       count[3] = 125;
       offset[0] = this->ActualTimeStep;
-      offset[1] = 0;
+      offset[1] = minId/125;
       offset[2] = i;
       offset[3] = 0;
       dataspace = H5Dget_space(data_id);
       H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
 
-      if(numPieces == 1)
-      {
-        status = H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT,
+      status = H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT,
             static_cast<vtkFloatArray *>(data)->GetPointer(0));
-      }
-      else
+      H5Sclose(dataspace);
+      H5Sclose(memspace);
+      output->GetPointData()->AddArray(data);
+      data->FastDelete();
+    }
+  }
+}
+
+// the variable contoured in CONTOUR_MODE, and used to cull the elements:
+// ContourArray if it is a variable of the current model, else the first one
+const char* vtkSalvusHDF5Reader::Get_Contour_Variable()
+{
+  for(const auto& varn : this->varnames[this->ModelName])
+  {
+    if(this->ContourArray && varn == this->ContourArray)
+      return varn.c_str();
+  }
+  return this->varnames[this->ModelName].front().c_str();
+}
+
+// the information-only ranges of the contour variable, at ActualTimeStep
+// and over all time steps
+void vtkSalvusHDF5Reader::Update_Contour_Array_Ranges()
+{
+  const char* vname = this->varnames[this->ModelName].empty() ? "" : this->Get_Contour_Variable();
+  if(!this->GetPointArrayRange(vname, this->ActualTimeStep, this->ContourArrayRange))
+  {
+    this->ContourArrayRange[0] = VTK_DOUBLE_MAX;
+    this->ContourArrayRange[1] = VTK_DOUBLE_MIN;
+  }
+  if(!this->GetPointArrayRange(vname, -1, this->ContourArrayGlobalRange))
+  {
+    this->ContourArrayGlobalRange[0] = VTK_DOUBLE_MAX;
+    this->ContourArrayGlobalRange[1] = VTK_DOUBLE_MIN;
+  }
+}
+
+// the features using the GLL basis assume that node i + 5*j + 25*k of an
+// element is GLL node (i, j, k). The hexahedra of the first element must
+// then be the ones of SalvusGLL::Hexahedra, in any order and with their
+// corners in any order.
+bool vtkSalvusHDF5Reader::Check_GLL_Node_Ordering(long int mesh_id)
+{
+  if(this->CellsPerElement != 64)
+    return false;
+  std::vector<long long> cells(8 * 64), expected(8 * 64);
+  hsize_t count[2] = {64, 8}, offset[2] = {0, 0}, memsize = 8 * 64;
+  hid_t dataspace = H5Dget_space(static_cast<hid_t>(mesh_id));
+  hid_t memspace = H5Screate_simple(1, &memsize, NULL);
+  H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+  herr_t status = H5Dread(static_cast<hid_t>(mesh_id), H5T_NATIVE_LLONG, memspace, dataspace, H5P_DEFAULT, cells.data());
+  H5Sclose(memspace);
+  H5Sclose(dataspace);
+  if(status < 0)
+    return false;
+
+  SalvusGLL::Hexahedra<long long>(0, expected.data());
+  std::vector<std::vector<long long>> found(64), wanted(64);
+  for(int c = 0; c < 64; c++)
+  {
+    found[c].assign(&cells[8 * c], &cells[8 * c + 8]);
+    wanted[c].assign(&expected[8 * c], &expected[8 * c + 8]);
+    std::sort(found[c].begin(), found[c].end());
+    std::sort(wanted[c].begin(), wanted[c].end());
+  }
+  std::sort(found.begin(), found.end());
+  std::sort(wanted.begin(), wanted.end());
+  return found == wanted;
+}
+
+// select the elements listed in runs along the element axis of a dataspace.
+// offset and count hold the other dimensions of the hyperslab.
+static void Select_Element_Runs(hid_t space, const std::vector<std::pair<long, long>>& runs,
+                                hsize_t* offset, hsize_t* count, int axis, hsize_t scale)
+{
+  H5Sselect_none(space);
+  for(const auto& run : runs)
+  {
+    offset[axis] = run.first * scale;
+    count[axis] = run.second * scale;
+    H5Sselect_hyperslab(space, H5S_SELECT_OR, offset, NULL, count, NULL);
+  }
+}
+
+// read the hexahedra of the piece, and only the nodes they use. With the
+// elements sorted along a Morton curve, these nodes form few runs of the
+// node tables. Runs separated by small gaps are read as one.
+int vtkSalvusHDF5Reader::Read_Viz_Layout(vtkUnstructuredGrid* output, const int piece, const int numPieces)
+{
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+  hsize_t count[2], offset[2];
+  hid_t memspace, dataspace;
+
+  if(this->ComputeGradients)
+    vtkWarningMacro(<< "gradients need the GLL nodes of the elements, they are not available in converted files");
+
+  hid_t f_id = H5Fopen(this->FileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t mesh_id = H5Dopen(f_id, (std::string("connectivity_") + model).c_str(), H5P_DEFAULT);
+  hid_t coords_id = H5Dopen(f_id, (std::string("coordinates_") + model).c_str(), H5P_DEFAULT);
+
+  long load = this->NbCells / numPieces;
+  long MyNumber_of_Cells = (piece < (numPieces-1)) ? load : this->NbCells - (numPieces-1) * load;
+
+  // same Nx9 trick as in RequestData(), the left-most column receives the value 8
+  vtkIdTypeArray *vtklistcells = vtkIdTypeArray::New();
+  vtklistcells->SetNumberOfValues(MyNumber_of_Cells * (8 + 1));
+  vtkIdType *destptr = vtklistcells->GetPointer(0);
+  count[0] = MyNumber_of_Cells;
+  count[1] = 8 + 1;
+  memspace = H5Screate_simple(2, count, NULL);
+  offset[0] = 0;
+  offset[1] = 1;
+  count[1] = 8;
+  H5Sselect_hyperslab(memspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+  offset[0] = piece * load;
+  offset[1] = 0;
+  dataspace = H5Dget_space(mesh_id);
+  H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+  H5Dread(mesh_id, (sizeof(vtkIdType) == H5Tget_size(H5T_NATIVE_INT)) ? H5T_NATIVE_INT : H5T_NATIVE_LLONG,
+          memspace, dataspace, H5P_DEFAULT, destptr);
+  H5Sclose(dataspace);
+  H5Sclose(memspace);
+  H5Dclose(mesh_id);
+
+  // the nodes of the piece, and the runs of the node tables covering them
+  std::vector<vtkIdType> nodeIds;
+  nodeIds.reserve(MyNumber_of_Cells * 2);
+  for(long i = 0; i < MyNumber_of_Cells; i++)
+  {
+    destptr[9 * i] = 8;
+    nodeIds.insert(nodeIds.end(), &destptr[9 * i + 1], &destptr[9 * i + 9]);
+  }
+  std::sort(nodeIds.begin(), nodeIds.end());
+  nodeIds.erase(std::unique(nodeIds.begin(), nodeIds.end()), nodeIds.end());
+  const long MyNumber_of_Nodes = static_cast<long>(nodeIds.size());
+
+  const long maxGap = 256;
+  ElementRuns runs;
+  std::vector<long> position(MyNumber_of_Nodes); // of every node in the runs
+  long covered = 0;
+  for(long i = 0; i < MyNumber_of_Nodes; i++)
+  {
+    if(runs.empty() || nodeIds[i] - (runs.back().first + runs.back().second) > maxGap)
+      runs.emplace_back(nodeIds[i], 0);
+    long extent = nodeIds[i] + 1 - runs.back().first;
+    covered += extent - runs.back().second;
+    runs.back().second = extent;
+    position[i] = covered - 1;
+  }
+
+  for(long i = 0; i < 9 * MyNumber_of_Cells; i++)
+    if(i % 9)
+      destptr[i] = std::lower_bound(nodeIds.begin(), nodeIds.end(), destptr[i]) - nodeIds.begin();
+  vtkCellArray *cells = vtkCellArray::New();
+  cells->SetCells(MyNumber_of_Cells, vtklistcells);
+  vtklistcells->FastDelete();
+  output->SetCells(VTK_HEXAHEDRON, cells);
+  cells->FastDelete();
+  this->UpdateProgress(0.30);
+
+  std::vector<float> buffer(3 * covered);
+  count[0] = covered;
+  count[1] = 3;
+  memspace = H5Screate_simple(2, count, NULL);
+  offset[1] = 0;
+  dataspace = H5Dget_space(coords_id);
+  Select_Element_Runs(dataspace, runs, offset, count, 0, 1);
+  H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, buffer.data());
+  H5Sclose(dataspace);
+  H5Sclose(memspace);
+  H5Dclose(coords_id);
+
+  vtkFloatArray *coords = vtkFloatArray::New();
+  coords->SetNumberOfComponents(3);
+  coords->SetNumberOfTuples(MyNumber_of_Nodes);
+  float *coordsptr = coords->GetPointer(0);
+  for(long i = 0; i < MyNumber_of_Nodes; i++)
+    memcpy(&coordsptr[3 * i], &buffer[3 * position[i]], 3 * sizeof(float));
+  vtkPoints *points = vtkPoints::New();
+  points->SetData(coords);
+  coords->FastDelete();
+  output->SetPoints(points);
+  points->FastDelete();
+  this->UpdateProgress(0.50);
+
+  // one row {1, nNodes} per time step
+  buffer.resize(covered);
+  hsize_t memsize = covered;
+  memspace = H5Screate_simple(1, &memsize, NULL);
+  for(const auto& varn : this->varnames[this->ModelName])
+  {
+    if(!this->Is_Variable_Enabled(varn.c_str()))
+      continue;
+    hid_t var_id = H5Dopen(f_id, SalvusVizLayout::Field(model, varn.c_str()).c_str(), H5P_DEFAULT);
+    dataspace = H5Dget_space(var_id);
+    offset[0] = this->ActualTimeStep;
+    count[0] = 1;
+    Select_Element_Runs(dataspace, runs, offset, count, 1, 1);
+    H5Dread(var_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, buffer.data());
+    H5Sclose(dataspace);
+    H5Dclose(var_id);
+
+    vtkFloatArray *data = vtkFloatArray::New();
+    data->SetName(varn.c_str());
+    data->SetNumberOfTuples(MyNumber_of_Nodes);
+    float *dataptr = data->GetPointer(0);
+    for(long i = 0; i < MyNumber_of_Nodes; i++)
+      dataptr[i] = buffer[position[i]];
+    output->GetPointData()->AddArray(data);
+    data->FastDelete();
+  }
+  H5Sclose(memspace);
+  H5Fclose(f_id);
+  this->UpdateProgress(1.0);
+  return 1;
+}
+
+// read the hexahedra, the coordinates and the enabled variables of the
+// spectral elements listed in runs, each run being {firstElement, numElements}.
+// The nodes of the kept elements are packed and numbered from 0. The
+// hexahedra are skipped if readCells is false.
+// This is called from a std::async thread in Extract_Streamed(), and must
+// remain the only place where HDF5 is called while a batch is in flight.
+vtkSmartPointer<vtkUnstructuredGrid> vtkSalvusHDF5Reader::Read_Element_Runs(long int mesh_dset, long int coords_dset, long int data_dset,
+                                                                            const ElementRuns& runs, bool readCells)
+{
+  hid_t mesh_id = static_cast<hid_t>(mesh_dset);
+  hid_t coords_id = static_cast<hid_t>(coords_dset);
+  hid_t data_id = static_cast<hid_t>(data_dset);
+  hsize_t count[4], offset[4];
+  hid_t memspace, dataspace;
+
+  long numElements = 0;
+  for(const auto& run : runs)
+    numElements += run.second;
+  const long numCells = numElements * this->CellsPerElement;
+  const long numNodes = numElements * 125;
+
+  vtkSmartPointer<vtkUnstructuredGrid> batch = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  if(numElements == 0)
+    return batch;
+
+  if(readCells)
+  {
+    // same Nx9 trick as in RequestData(), the left-most column receives the value 8
+    vtkIdTypeArray *vtklistcells = vtkIdTypeArray::New();
+    vtklistcells->SetNumberOfValues(numCells * (8 + 1));
+    vtkIdType *destptr = vtklistcells->GetPointer(0);
+
+    count[0] = numCells;
+    count[1] = 8 + 1;
+    memspace = H5Screate_simple(2, count, NULL);
+    offset[0] = 0;
+    offset[1] = 1;
+    count[1] = 8;
+    H5Sselect_hyperslab(memspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+
+    dataspace = H5Dget_space(mesh_id);
+    offset[1] = 0;
+    Select_Element_Runs(dataspace, runs, offset, count, 0, this->CellsPerElement);
+
+    if (sizeof(vtkIdType) == H5Tget_size(H5T_NATIVE_INT))
+      H5Dread(mesh_id, H5T_NATIVE_INT, memspace, dataspace, H5P_DEFAULT, destptr);
+    else if (sizeof(vtkIdType) == H5Tget_size(H5T_NATIVE_LONG))
+      H5Dread(mesh_id, H5T_NATIVE_LONG, memspace, dataspace, H5P_DEFAULT, destptr);
+    else
+      cerr << "type&size error while reading element connectivity\n";
+    H5Sclose(dataspace);
+    H5Sclose(memspace);
+
+    vtkIdType packedNode = 0;
+    for(const auto& run : runs)
+    {
+      const vtkIdType shift = run.first * 125 - packedNode;
+      for(long i = 0; i < run.second * this->CellsPerElement; i++)
       {
-        status = H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, data0);
-          // void *memcpy(void *dest, const void *src, size_t n);
-        memcpy(static_cast<vtkFloatArray *>(data)->GetPointer(0),
-                 &data0[minId], 
-                 sizeof(float) * MyNumber_of_Nodes);
+        *destptr++ = 8;
+        for(int j = 0; j < 8; j++)
+        {
+          (*destptr) -= shift;
+          destptr++;
+        }
       }
-      output->GetPointData()->AddArray(data);
+      packedNode += run.second * 125;
+    }
+    vtkCellArray *cells = vtkCellArray::New();
+    cells->SetCells(numCells, vtklistcells);
+    vtklistcells->FastDelete();
+    batch->SetCells(VTK_HEXAHEDRON, cells);
+    cells->FastDelete();
+  }
+
+  vtkFloatArray *coords = vtkFloatArray::New();
+  coords->SetNumberOfComponents(3);
+  coords->SetNumberOfTuples(numNodes);
+
+  count[0] = numNodes;
+  count[1] = 3;
+  memspace = H5Screate_simple(2, count, NULL);
+
+  count[1] = 125;
+  count[2] = 3;
+  offset[1] = 0;
+  offset[2] = 0;
+  dataspace = H5Dget_space(coords_id);
+  Select_Element_Runs(dataspace, runs, offset, count, 0, 1);
+  H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, coords->GetPointer(0));
+  H5Sclose(dataspace);
+  H5Sclose(memspace);
+
+  vtkPoints *points = vtkPoints::New();
+  points->SetData(coords);
+  coords->FastDelete();
+  batch->SetPoints(points);
+  points->FastDelete();
+
+  for(int i=0; i < this->varnames[this->ModelName].size(); i++)
+  {
+    const char *vname = this->varnames[this->ModelName][i].c_str();
+    if(this->Is_Variable_Enabled(vname) ||
+       (this->OutputMode == CONTOUR_MODE && !strcmp(vname, this->Get_Contour_Variable())))
+    {
+      vtkFloatArray *data = vtkFloatArray::New();
+      data->SetNumberOfComponents(1);
+      data->SetNumberOfTuples(numNodes);
+      data->SetName(vname);
+
+      count[0] = numNodes;
+      memspace = H5Screate_simple(1, count, NULL);
+
+      count[0] = 1; // timestep slice
+      count[2] = 1;
+      count[3] = 125;
+      offset[0] = this->ActualTimeStep;
+      offset[2] = i;
+      offset[3] = 0;
+      dataspace = H5Dget_space(data_id);
+      Select_Element_Runs(dataspace, runs, offset, count, 1, 1);
+      H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, data->GetPointer(0));
+      H5Sclose(dataspace);
+      H5Sclose(memspace);
+
+      batch->GetPointData()->AddArray(data);
       data->FastDelete();
     }
   }
-  if(numPieces > 1)
+  if(this->ComputeGradients)
+    this->Compute_Gradients(batch->GetPointData(), coords->GetPointer(0), numElements);
+  return batch;
+}
+
+// derivatives of the GLL interpolant of every point array, element by
+// element. With J the Jacobian of the element map at a node, the gradient is
+// J^-T times the reference derivatives, which are tensor-product sums with
+// the 5x5 differentiation matrix D[a][m] = l_m'(x_a).
+void vtkSalvusHDF5Reader::Compute_Gradients(vtkPointData* pd, const float* coords, long numElements)
+{
+  if(!this->GLLNodeOrdering)
+    return;
+  double D[5][5];
+  for(int a = 0; a < 5; a++)
+  {
+    double dl[5];
+    SalvusGLL::LagrangeDerivative(SalvusGLL::Points[a], dl);
+    for(int m = 0; m < 5; m++)
+      D[a][m] = dl[m];
+  }
+
+  std::vector<const float*> inputs;
+  std::vector<float*> outputs;
+  std::vector<std::string> names;
+  const int NbArrays = pd->GetNumberOfArrays();
+  for(int i = 0; i < NbArrays; i++)
   {
-    delete [] data0;
+    vtkFloatArray* data = vtkFloatArray::SafeDownCast(pd->GetArray(i));
+    if(!data || data->GetNumberOfComponents() != 1)
+      continue;
+    vtkFloatArray* grad = vtkFloatArray::New();
+    grad->SetNumberOfComponents(3);
+    grad->SetNumberOfTuples(data->GetNumberOfTuples());
+    std::string name = std::string("grad_") + data->GetName();
+    grad->SetName(name.c_str());
+    inputs.push_back(data->GetPointer(0));
+    outputs.push_back(grad->GetPointer(0));
+    names.push_back(data->GetName());
+    pd->AddArray(grad);
+    grad->FastDelete();
   }
+
+  vtkSMPTools::For(0, numElements, [&](vtkIdType begin, vtkIdType end) {
+    double invJ[125][3][3];
+    for(vtkIdType e = begin; e < end; e++)
+    {
+      const float* X = coords + e * 125 * 3;
+      for(int k = 0; k < 5; k++)
+        for(int j = 0; j < 5; j++)
+          for(int i = 0; i < 5; i++)
+          {
+            double J[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+            for(int m = 0; m < 5; m++)
+              for(int d = 0; d < 3; d++)
+              {
+                J[d][0] += D[i][m] * X[3 * (m + 5 * j + 25 * k) + d];
+                J[d][1] += D[j][m] * X[3 * (i + 5 * m + 25 * k) + d];
+                J[d][2] += D[k][m] * X[3 * (i + 5 * j + 25 * m) + d];
+              }
+            double (*inv)[3] = invJ[i + 5 * j + 25 * k];
+            if(SalvusGLL::Invert3x3(J, inv) == 0.0) // degenerate element
+              for(int d = 0; d < 3; d++)
+                inv[d][0] = inv[d][1] = inv[d][2] = 0.0;
+          }
+
+      for(size_t v = 0; v < inputs.size(); v++)
+      {
+        const float* u = inputs[v] + e * 125;
+        float* grad = outputs[v] + e * 125 * 3;
+        for(int k = 0; k < 5; k++)
+          for(int j = 0; j < 5; j++)
+            for(int i = 0; i < 5; i++)
+            {
+              double du[3] = {0.0, 0.0, 0.0};
+              for(int m = 0; m < 5; m++)
+              {
+                du[0] += D[i][m] * u[m + 5 * j + 25 * k];
+                du[1] += D[j][m] * u[i + 5 * m + 25 * k];
+                du[2] += D[k][m] * u[i + 5 * j + 25 * m];
+              }
+              const int n = i + 5 * j + 25 * k;
+              for(int d = 0; d < 3; d++)
+                grad[3 * n + d] = invJ[n][0][d] * du[0] + invJ[n][1][d] * du[1] + invJ[n][2][d] * du[2];
+            }
+      }
+    }
+  });
+
+  // divergence of the stress tensor, when all its components are there
+  std::map<std::string, const float*> grads;
+  for(size_t v = 0; v < names.size(); v++)
+    grads[names[v]] = outputs[v];
+  if(grads.size() == 6 && this->ModelName == ELASTIC)
+  {
+    const float* g[3][3] = {{grads["stress_xx"], grads["stress_xy"], grads["stress_xz"]},
+                            {grads["stress_xy"], grads["stress_yy"], grads["stress_yz"]},
+                            {grads["stress_xz"], grads["stress_yz"], grads["stress_zz"]}};
+    vtkFloatArray* div = vtkFloatArray::New();
+    div->SetNumberOfComponents(3);
+    div->SetNumberOfTuples(numElements * 125);
+    div->SetName("div_stress");
+    float* dv = div->GetPointer(0);
+    vtkSMPTools::For(0, numElements * 125, [&](vtkIdType begin, vtkIdType end) {
+      for(vtkIdType n = begin; n < end; n++)
+        for(int r = 0; r < 3; r++)
+          dv[3 * n + r] = g[r][0][3 * n] + g[r][1][3 * n + 1] + g[r][2][3 * n + 2];
+    });
+    pd->AddArray(div);
+    div->FastDelete();
+  }
+}
+
+vtkSmartPointer<vtkPolyData> vtkSalvusHDF5Reader::Extract_Batch(vtkUnstructuredGrid* batch, const ElementRuns& runs)
+{
+  if(this->OutputMode == SURFACE_MODE)
+  {
+    return this->Extract_Surface(batch, runs);
+  }
+  else if(this->OutputMode == CONTOUR_MODE)
+  {
+    vtkNew<vtkContourFilter> contour;
+    contour->SetInputData(batch);
+    contour->SetInputArrayToProcess(0, 0, 0, vtkDataObject::FIELD_ASSOCIATION_POINTS,
+                                    this->Get_Contour_Variable());
+    contour->SetNumberOfContours(static_cast<int>(this->ContourValues.size()));
+    for(int i=0; i < this->ContourValues.size(); i++)
+      contour->SetValue(i, this->ContourValues[i]);
+    contour->ComputeScalarsOn();
+    contour->Update();
+    return contour->GetOutput();
+  }
+  else
+  {
+    vtkNew<vtkPlane> plane;
+    plane->SetOrigin(this->SliceOrigin);
+    plane->SetNormal(this->SliceNormal);
+    vtkNew<vtkCutter> cutter;
+    cutter->SetInputData(batch);
+    cutter->SetCutFunction(plane);
+    cutter->Update();
+    return cutter->GetOutput();
+  }
+}
+
+// Streamed extraction: the elements of this piece are read in batches of
+// this->BatchSize elements, each batch is contoured (or sliced, or reduced
+// to its boundary faces) and then released, so that the full
+// vtkUnstructuredGrid is never built. Batch b+1
+// is read by a std::async task while batch b is being processed.
+int vtkSalvusHDF5Reader::Extract_Streamed(vtkPolyData* output, const int piece, const int numPieces)
+{
+  if(this->OutputMode == CONTOUR_MODE)
+  {
+    // a variable of the other model is expected when switching models
+    const auto& other = this->varnames[1 - this->ModelName];
+    if(this->ContourArray && this->ContourArray[0] && strcmp(this->ContourArray, this->Get_Contour_Variable()) &&
+       std::find(other.begin(), other.end(), this->ContourArray) == other.end())
+      vtkWarningMacro(<< this->ContourArray << " is not a variable of this model, contouring "
+                      << this->Get_Contour_Variable());
+    if(this->ContourValues.empty())
+    {
+      vtkWarningMacro(<< "no contour values were given");
+      return 1;
+    }
+  }
+
+  hid_t root_id, mesh_id, coords_id, volume_id, data_id;
+  file_id = H5Fopen(this->FileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+  root_id = H5Gopen(file_id, "/", H5P_DEFAULT);
+  volume_id = H5Gopen(root_id, "volume", H5P_DEFAULT);
+  if(this->ModelName == ELASTIC)
+  {
+    mesh_id   = H5Dopen(root_id, "connectivity_ELASTIC", H5P_DEFAULT);
+    coords_id = H5Dopen(root_id, "coordinates_ELASTIC", H5P_DEFAULT);
+    data_id   = H5Dopen(volume_id, "stress", H5P_DEFAULT);
+  }
+  else
+  {
+    mesh_id   = H5Dopen(root_id, "connectivity_ACOUSTIC", H5P_DEFAULT);
+    coords_id = H5Dopen(root_id, "coordinates_ACOUSTIC", H5P_DEFAULT);
+    data_id   = H5Dopen(volume_id, "phi_tt", H5P_DEFAULT);
+  }
+
+  // the elements of this piece which may intersect the isovalues (or the
+  // value range) are split in batches of at most this->BatchSize elements
+  long MyFirst_Element, MyNumber_of_Elements;
+  ElementRuns pieceRuns;
+  this->Get_Piece_Elements(piece, numPieces, MyFirst_Element, MyNumber_of_Elements);
+  if(this->OutputMode == SURFACE_MODE)
+    this->Select_Boundary_Elements(MyFirst_Element, MyNumber_of_Elements, pieceRuns);
+  else
+    this->Select_Elements(MyFirst_Element, MyNumber_of_Elements, pieceRuns);
+
+  std::vector<ElementRuns> batches;
+  long batchCount = this->BatchSize;
+  for(auto run : pieceRuns)
+  {
+    while(run.second > 0)
+    {
+      if(batchCount == this->BatchSize)
+      {
+        batches.emplace_back();
+        batchCount = 0;
+      }
+      long n = std::min(run.second, this->BatchSize - batchCount);
+      batches.back().emplace_back(run.first, n);
+      run.first += n;
+      run.second -= n;
+      batchCount += n;
+    }
+  }
+  long NbBatches = static_cast<long>(batches.size());
+
+  auto readBatch = [&](long b) {
+    return this->Read_Element_Runs(mesh_id, coords_id, data_id, batches[b], this->OutputMode != SURFACE_MODE);
+  };
+
+  vtkNew<vtkAppendPolyData> append;
+  std::future<vtkSmartPointer<vtkUnstructuredGrid>> nextBatch;
+  if(NbBatches > 0)
+    nextBatch = std::async(std::launch::async, readBatch, 0L);
+
+  for(long b = 0; b < NbBatches; b++)
+  {
+    vtkSmartPointer<vtkUnstructuredGrid> batch = nextBatch.get();
+    if(b + 1 < NbBatches)
+      nextBatch = std::async(std::launch::async, readBatch, b + 1);
+
+    vtkSmartPointer<vtkPolyData> extract = this->Extract_Batch(batch, batches[b]);
+    batch = nullptr;
+    if(extract->GetNumberOfPoints() > 0)
+      append->AddInputData(extract);
+    this->UpdateProgress(static_cast<double>(b + 1) / NbBatches);
+  }
+
+  H5Dclose(data_id);
+  H5Dclose(coords_id);
+  H5Dclose(mesh_id);
+  H5Gclose(volume_id);
+  H5Gclose(root_id);
+  H5Fclose(file_id);
+
+  if(append->GetNumberOfInputConnections(0) > 0)
+  {
+    append->Update();
+    output->ShallowCopy(append->GetOutput());
+  }
+  return 1;
+}
+
+void vtkSalvusHDF5Reader::Get_Piece_Elements(const int piece, const int numPieces, long& firstElement, long& numElements)
+{
+  long NbElements = this->NbNodes / 125;
+  long load = NbElements / numPieces;
+  firstElement = piece * load;
+  numElements = (piece < (numPieces-1)) ? load : NbElements - (numPieces-1) * load;
+}
+
+// The first process of every node reads the elements of all the processes of
+// the node into one shared-memory window:
+//   [offsets (8 * i) of the largest piece][connectivity of every piece][coordinates of every piece]
+// and every process wraps its own slices, without copy. The connectivity is
+// renumbered to start at 0 in each piece.
+// Collective on all processes, which must each read the piece of their rank.
+// Returns 0 if MPI is not used, the caller then reads a private copy of the
+// geometry.
+// When the layout changes, the previous window is kept while the pipeline
+// holds datasets using it, and freed by a later call once the arrays wrapping
+// it are released on all the processes.
+int vtkSalvusHDF5Reader::Load_Shared_Geometry(vtkUnstructuredGrid* output, long int mesh_id, long int coords_id,
+                                              long firstElement, long numElements)
+{
+  vtkMultiProcessController* controller = vtkMultiProcessController::GetGlobalController();
+  vtkMPICommunicator* communicator = controller ?
+    vtkMPICommunicator::SafeDownCast(controller->GetCommunicator()) : nullptr;
+  if(!communicator || !communicator->GetMPIComm()->GetHandle())
+    return 0;
+  MPI_Comm world = *communicator->GetMPIComm()->GetHandle();
+  vtkSalvusSharedGeometry* shared = this->SharedGeometry;
+
+  std::ostringstream source;
+  source << this->FileName << ":" << this->ModelName << ":" << firstElement << ":" << numElements;
+  int changed = (source.str() != shared->Source), anyChanged = 0;
+  MPI_Allreduce(&changed, &anyChanged, 1, MPI_INT, MPI_MAX, world);
+  if(anyChanged)
+    shared->Retire();
+  // the output was reset by the executive, it does not hold the views any more
+  shared->Free_Retired(world, false);
+  if(anyChanged)
+  {
+
+    int nodeRank, nodeSize;
+    MPI_Comm_split_type(world, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shared->NodeComm);
+    MPI_Comm_rank(shared->NodeComm, &nodeRank);
+    MPI_Comm_size(shared->NodeComm, &nodeSize);
+
+    // {firstElement, numElements} of every process of the node
+    long mine[2] = {firstElement, numElements};
+    std::vector<long> pieces(2 * nodeSize);
+    MPI_Allgather(mine, 2, MPI_LONG, pieces.data(), 2, MPI_LONG, shared->NodeComm);
+    std::vector<long> firstNode(nodeSize + 1, 0), firstCell(nodeSize + 1, 0);
+    long maxCells = 0;
+    for(int r = 0; r < nodeSize; r++)
+    {
+      firstNode[r + 1] = firstNode[r] + pieces[2 * r + 1] * 125;
+      firstCell[r + 1] = firstCell[r] + pieces[2 * r + 1] * this->CellsPerElement;
+      maxCells = std::max(maxCells, pieces[2 * r + 1] * this->CellsPerElement);
+    }
+    MPI_Aint offsetsBytes = (maxCells + 1) * sizeof(vtkIdType);
+    MPI_Aint connBytes = firstCell[nodeSize] * 8 * sizeof(vtkIdType);
+    MPI_Aint coordsBytes = firstNode[nodeSize] * 3 * sizeof(float);
+
+    char* base = nullptr;
+    MPI_Win_allocate_shared(nodeRank == 0 ? offsetsBytes + connBytes + coordsBytes : 0, 1,
+                            MPI_INFO_NULL, shared->NodeComm, &base, &shared->Window);
+    MPI_Aint size;
+    int dispUnit;
+    MPI_Win_shared_query(shared->Window, 0, &size, &dispUnit, &base);
+    vtkIdType* offsets = reinterpret_cast<vtkIdType*>(base);
+    vtkIdType* conn = reinterpret_cast<vtkIdType*>(base + offsetsBytes);
+    float* coords = reinterpret_cast<float*>(base + offsetsBytes + connBytes);
+
+    MPI_Win_fence(0, shared->Window);
+    if(nodeRank == 0)
+    {
+      for(long i = 0; i <= maxCells; i++)
+        offsets[i] = 8 * i;
+
+      hid_t memspace, dataspace;
+      hsize_t count[3], offset[3];
+      hid_t idType = (sizeof(vtkIdType) == H5Tget_size(H5T_NATIVE_INT)) ? H5T_NATIVE_INT : H5T_NATIVE_LONG;
+      for(int r = 0; r < nodeSize; r++)
+      {
+        long first = pieces[2 * r], n = pieces[2 * r + 1];
+        if(n == 0)
+          continue;
+        count[0] = n * this->CellsPerElement;
+        count[1] = 8;
+        offset[0] = first * this->CellsPerElement;
+        offset[1] = 0;
+        memspace = H5Screate_simple(2, count, NULL);
+        dataspace = H5Dget_space(mesh_id);
+        H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+        if(H5Dread(mesh_id, idType, memspace, dataspace, H5P_DEFAULT, &conn[8 * firstCell[r]]) < 0)
+          vtkErrorMacro(<< "error reading the connectivity of elements " << first << " to " << first + n - 1);
+        H5Sclose(dataspace);
+        H5Sclose(memspace);
+        for(long i = 8 * firstCell[r]; i < 8 * firstCell[r + 1]; i++)
+          conn[i] -= first * 125;
+
+        count[0] = n;
+        count[1] = 125;
+        count[2] = 3;
+        offset[0] = first;
+        offset[1] = 0;
+        offset[2] = 0;
+        memspace = H5Screate_simple(3, count, NULL);
+        dataspace = H5Dget_space(coords_id);
+        H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+        if(H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, &coords[3 * firstNode[r]]) < 0)
+          vtkErrorMacro(<< "error reading the coordinates of elements " << first << " to " << first + n - 1);
+        H5Sclose(dataspace);
+        H5Sclose(memspace);
+      }
+    }
+    MPI_Win_fence(0, shared->Window);
+
+    // read-only views of the slices of this process. save = 1: the memory
+    // belongs to the window
+    long myCells = numElements * this->CellsPerElement;
+    vtkNew<vtkFloatArray> points;
+    points->SetNumberOfComponents(3);
+    points->SetArray(&coords[3 * firstNode[nodeRank]], 3 * numElements * 125, 1);
+    vtkNew<vtkIdTypeArray> offsetsArray;
+    offsetsArray->SetArray(offsets, myCells + 1, 1);
+    vtkNew<vtkIdTypeArray> connArray;
+    connArray->SetArray(&conn[8 * firstCell[nodeRank]], 8 * myCells, 1);
+
+    shared->Points = vtkSmartPointer<vtkPoints>::New();
+    shared->Points->SetData(points);
+    shared->Cells = vtkSmartPointer<vtkCellArray>::New();
+    shared->Cells->SetData(offsetsArray, connArray);
+    shared->Views = {points.GetPointer(), offsetsArray.GetPointer(), connArray.GetPointer()};
+    shared->Source = source.str();
+  }
+
+  output->SetPoints(shared->Points);
+  output->SetCells(VTK_HEXAHEDRON, shared->Cells);
+  return 1;
+}
+
+// frees the current and the retired windows, used or not, when the reader is
+// destroyed. Collective on the processes of the node.
+void vtkSalvusHDF5Reader::Release_Shared_Geometry()
+{
+  vtkSalvusSharedGeometry* shared = this->SharedGeometry;
+  shared->Retire();
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if(!finalized)
+    shared->Free_Retired(MPI_COMM_NULL, true);
+  shared->Retired.clear();
+}
+
+std::string vtkSalvusHDF5Reader::Get_Range_Cache_Name()
+{
+  if(this->RangeCacheFileName && strlen(this->RangeCacheFileName))
+    return this->RangeCacheFileName;
+  return std::string(this->FileName) + ".ranges.h5";
+}
+
+// increased when the content of each cache changes
+static const int RangeCacheVersion = 1;
+static const int BoundaryCacheVersion = 2;
+
+// the cache files have one entry per model, and are valid if not older than
+// the data file, and if the attributes of the entry match the data file and
+// the version of the cache.
+// In the range cache, the entry is a group. For each variable, the dataset
+// <var> {T, nElem, 2} holds the per-element min/max, and the dataset
+// <var>_steps {T, 2} the min/max of every time step.
+bool vtkSalvusHDF5Reader::Is_Cache_Valid(const std::string& cacheName, int version)
+{
+  int result = -1;
+  if(!vtksys::SystemTools::FileExists(cacheName) ||
+     !vtksys::SystemTools::FileTimeCompare(cacheName, this->FileName, &result) ||
+     result < 0) // older than the data file
+    return false;
+
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+  bool found = false;
+  hid_t cache_id = H5Fopen(cacheName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  if(cache_id >= 0)
+  {
+    if(H5Lexists(cache_id, model, H5P_DEFAULT) > 0)
+    {
+      hid_t entry_id = H5Oopen(cache_id, model, H5P_DEFAULT);
+      found = this->Check_Cache_Attributes(entry_id, version);
+      H5Oclose(entry_id);
+    }
+    H5Fclose(cache_id);
+  }
+  return found;
+}
+
+// the data file, number of time steps and number of elements a cache entry
+// was built for
+void vtkSalvusHDF5Reader::Set_Cache_Attributes(long int object_id, int version)
+{
+  hid_t obj_id = static_cast<hid_t>(object_id);
+  std::string source = vtksys::SystemTools::CollapseFullPath(this->FileName);
+  long long sizes[3] = {version, this->NumberOfTimeSteps, this->NbNodes / 125};
+  const char* names[3] = {"cache_version", "number_of_time_steps", "number_of_elements"};
+
+  hid_t space = H5Screate(H5S_SCALAR);
+  hid_t type = H5Tcopy(H5T_C_S1);
+  H5Tset_size(type, source.size() + 1);
+  hid_t attr = H5Acreate(obj_id, "source_file", type, space, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attr, type, source.c_str());
+  H5Aclose(attr);
+  H5Tclose(type);
+  for(int i = 0; i < 3; i++)
+  {
+    attr = H5Acreate(obj_id, names[i], H5T_NATIVE_LLONG, space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, H5T_NATIVE_LLONG, &sizes[i]);
+    H5Aclose(attr);
+  }
+  H5Sclose(space);
+}
+
+bool vtkSalvusHDF5Reader::Check_Cache_Attributes(long int object_id, int version)
+{
+  hid_t obj_id = static_cast<hid_t>(object_id);
+  long long sizes[3] = {version, this->NumberOfTimeSteps, this->NbNodes / 125};
+  const char* names[3] = {"cache_version", "number_of_time_steps", "number_of_elements"};
+  for(int i = 0; i < 3; i++)
+  {
+    long long value = -1;
+    if(H5Aexists(obj_id, names[i]) <= 0)
+      return false;
+    hid_t attr = H5Aopen(obj_id, names[i], H5P_DEFAULT);
+    herr_t status = H5Aread(attr, H5T_NATIVE_LLONG, &value);
+    H5Aclose(attr);
+    if(status < 0 || value != sizes[i])
+      return false;
+  }
+
+  if(H5Aexists(obj_id, "source_file") <= 0)
+    return false;
+  hid_t attr = H5Aopen(obj_id, "source_file", H5P_DEFAULT);
+  hid_t type = H5Aget_type(attr);
+  bool valid = false;
+  if(H5Tget_class(type) == H5T_STRING && !H5Tis_variable_str(type))
+  {
+    std::vector<char> source(H5Tget_size(type) + 1, '\0');
+    if(H5Aread(attr, type, source.data()) >= 0)
+      valid = (vtksys::SystemTools::CollapseFullPath(this->FileName) == source.data());
+  }
+  H5Tclose(type);
+  H5Aclose(attr);
+  return valid;
+}
+
+// one pass over the field data, by time step and by batch of elements
+int vtkSalvusHDF5Reader::Build_Range_Cache(const std::string& cacheName)
+{
+  hsize_t count[4], offset[4], dimsf[3];
+  hid_t root_id, volume_id, data_id, memspace, dataspace, cache_id, group_id;
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+  const std::vector<std::string>& vars = this->varnames[this->ModelName];
+  const int NbComponents = static_cast<int>(vars.size());
+  const long NbElements = this->NbNodes / 125;
+
+  if(vtksys::SystemTools::FileExists(cacheName))
+    cache_id = H5Fopen(cacheName.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+  else
+    cache_id = H5Fcreate(cacheName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if(cache_id < 0)
+  {
+    vtkWarningMacro(<< "cannot write the range cache " << cacheName);
+    return 0;
+  }
+  // a stale group is replaced. The new group is only renamed once complete.
+  if(H5Lexists(cache_id, model, H5P_DEFAULT) > 0)
+    H5Ldelete(cache_id, model, H5P_DEFAULT);
+  std::string tmpName = std::string(model) + "_incomplete";
+  if(H5Lexists(cache_id, tmpName.c_str(), H5P_DEFAULT) > 0)
+    H5Ldelete(cache_id, tmpName.c_str(), H5P_DEFAULT);
+  group_id = H5Gcreate(cache_id, tmpName.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+  std::vector<hid_t> ranges_id(NbComponents);
+  dimsf[0] = this->NumberOfTimeSteps;
+  dimsf[1] = NbElements;
+  dimsf[2] = 2;
+  dataspace = H5Screate_simple(3, dimsf, NULL);
+  for(int c = 0; c < NbComponents; c++)
+    ranges_id[c] = H5Dcreate(group_id, vars[c].c_str(), H5T_NATIVE_FLOAT, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Sclose(dataspace);
+
+  hid_t f_id = H5Fopen(this->FileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+  root_id = H5Gopen(f_id, "/", H5P_DEFAULT);
+  volume_id = H5Gopen(root_id, "volume", H5P_DEFAULT);
+  data_id = H5Dopen(volume_id, (this->ModelName == ELASTIC) ? "stress" : "phi_tt", H5P_DEFAULT);
+
+  std::vector<double> steps(NbComponents * this->NumberOfTimeSteps * 2);
+  for(int t = 0; t < this->NumberOfTimeSteps; t++)
+  {
+    for(int c = 0; c < NbComponents; c++)
+    {
+      steps[(c * this->NumberOfTimeSteps + t) * 2]     = VTK_DOUBLE_MAX;
+      steps[(c * this->NumberOfTimeSteps + t) * 2 + 1] = VTK_DOUBLE_MIN;
+    }
+  }
+
+  std::vector<float> values(static_cast<size_t>(this->BatchSize) * NbComponents * 125);
+  std::vector<float> minmax(static_cast<size_t>(this->BatchSize) * 2);
+  for(int t = 0; t < this->NumberOfTimeSteps; t++)
+  {
+    for(long first = 0; first < NbElements; first += this->BatchSize)
+    {
+      long n = std::min(static_cast<long>(this->BatchSize), NbElements - first);
+
+      count[0] = n * NbComponents * 125;
+      memspace = H5Screate_simple(1, count, NULL);
+      count[0] = 1;
+      count[1] = n;
+      count[2] = NbComponents;
+      count[3] = 125;
+      offset[0] = t;
+      offset[1] = first;
+      offset[2] = 0;
+      offset[3] = 0;
+      dataspace = H5Dget_space(data_id);
+      H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+      H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, values.data());
+      H5Sclose(dataspace);
+      H5Sclose(memspace);
+
+      for(int c = 0; c < NbComponents; c++)
+      {
+        double* step = &steps[(c * this->NumberOfTimeSteps + t) * 2];
+        for(long e = 0; e < n; e++)
+        {
+          const float* v = &values[(e * NbComponents + c) * 125];
+          const auto mm = std::minmax_element(v, v + 125);
+          minmax[2 * e]     = *mm.first;
+          minmax[2 * e + 1] = *mm.second;
+          step[0] = std::min(step[0], static_cast<double>(*mm.first));
+          step[1] = std::max(step[1], static_cast<double>(*mm.second));
+        }
+        count[0] = n * 2;
+        memspace = H5Screate_simple(1, count, NULL);
+        count[0] = 1;
+        count[1] = n;
+        count[2] = 2;
+        offset[0] = t;
+        offset[1] = first;
+        offset[2] = 0;
+        dataspace = H5Dget_space(ranges_id[c]);
+        H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+        H5Dwrite(ranges_id[c], H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, minmax.data());
+        H5Sclose(dataspace);
+        H5Sclose(memspace);
+      }
+    }
+    this->UpdateProgress(static_cast<double>(t + 1) / this->NumberOfTimeSteps);
+  }
+
+  dimsf[0] = this->NumberOfTimeSteps;
+  dimsf[1] = 2;
+  dataspace = H5Screate_simple(2, dimsf, NULL);
+  for(int c = 0; c < NbComponents; c++)
+  {
+    std::string stepsName = vars[c] + "_steps";
+    hid_t steps_id = H5Dcreate(group_id, stepsName.c_str(), H5T_NATIVE_DOUBLE, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(steps_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &steps[c * this->NumberOfTimeSteps * 2]);
+    H5Dclose(steps_id);
+    H5Dclose(ranges_id[c]);
+  }
+  H5Sclose(dataspace);
+
+  H5Dclose(data_id);
+  H5Gclose(volume_id);
+  H5Gclose(root_id);
+  H5Fclose(f_id);
+
+  this->Set_Cache_Attributes(group_id, RangeCacheVersion);
+  H5Gclose(group_id);
+  H5Lmove(cache_id, tmpName.c_str(), cache_id, model, H5P_DEFAULT, H5P_DEFAULT);
+  H5Fclose(cache_id);
+  return 1;
+}
+
+// make sure the range cache exists, then load the ranges of every time step
+int vtkSalvusHDF5Reader::Update_Range_Cache()
+{
+  this->StepRanges.clear();
+  this->ElementRangesAvailable = false;
+  if(!(this->UseElementRanges || this->ValueRangeFilter) || this->NumberOfTimeSteps == 0 || this->VizLayout)
+    return 0;
+
+  std::string cacheName = this->Get_Range_Cache_Name();
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+
+  // in parallel, the cache is built once, by the first process
+  vtkMultiProcessController* controller = vtkMultiProcessController::GetGlobalController();
+  int rank = controller ? controller->GetLocalProcessId() : 0;
+  if(rank == 0 && !this->Is_Cache_Valid(cacheName, RangeCacheVersion))
+    this->Build_Range_Cache(cacheName);
+  if(controller && controller->GetNumberOfProcesses() > 1)
+    controller->Barrier();
+
+  if(!this->Is_Cache_Valid(cacheName, RangeCacheVersion))
+    return 0;
+
+  hid_t cache_id = H5Fopen(cacheName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t group_id = H5Gopen(cache_id, model, H5P_DEFAULT);
+  for(const auto& varn : this->varnames[this->ModelName])
+  {
+    std::string stepsName = varn + "_steps";
+    if(H5Lexists(group_id, stepsName.c_str(), H5P_DEFAULT) > 0)
+    {
+      std::vector<double> steps(this->NumberOfTimeSteps * 2);
+      hsize_t dimsf[2] = {0, 0};
+      hid_t steps_id = H5Dopen(group_id, stepsName.c_str(), H5P_DEFAULT);
+      hid_t dataspace = H5Dget_space(steps_id);
+      bool valid = H5Sget_simple_extent_ndims(dataspace) == 2;
+      H5Sget_simple_extent_dims(dataspace, dimsf, NULL);
+      valid = valid && dimsf[0] == static_cast<hsize_t>(this->NumberOfTimeSteps) && dimsf[1] == 2 &&
+        H5Dread(steps_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, steps.data()) >= 0;
+      H5Sclose(dataspace);
+      H5Dclose(steps_id);
+      if(valid)
+        this->StepRanges[varn].swap(steps);
+      else
+        vtkWarningMacro(<< "ignoring the invalid dataset " << stepsName << " of " << cacheName);
+    }
+  }
+  H5Gclose(group_id);
+  H5Fclose(cache_id);
+
+  this->ElementRangesAvailable = (this->StepRanges.size() == this->varnames[this->ModelName].size());
+  return this->ElementRangesAvailable;
+}
+
+int vtkSalvusHDF5Reader::GetPointArrayRange(const char* name, int timeStep, double range[2])
+{
+  auto it = this->StepRanges.find(name);
+  if(it == this->StepRanges.end() || timeStep >= this->NumberOfTimeSteps)
+    return 0;
+  const std::vector<double>& steps = it->second;
+  if(timeStep >= 0)
+  {
+    range[0] = steps[2 * timeStep];
+    range[1] = steps[2 * timeStep + 1];
+  }
+  else
+  {
+    range[0] = VTK_DOUBLE_MAX;
+    range[1] = VTK_DOUBLE_MIN;
+    for(int t = 0; t < this->NumberOfTimeSteps; t++)
+    {
+      range[0] = std::min(range[0], steps[2 * t]);
+      range[1] = std::max(range[1], steps[2 * t + 1]);
+    }
+  }
+  return 1;
+}
+
+bool vtkSalvusHDF5Reader::Is_Element_Needed(float minValue, float maxValue)
+{
+  if(this->ValueRangeFilter && (maxValue < this->ValueRange[0] || minValue > this->ValueRange[1]))
+    return false;
+  if(this->OutputMode == CONTOUR_MODE)
+  {
+    for(double value : this->ContourValues)
+    {
+      if(minValue <= value && value <= maxValue)
+        return true;
+    }
+    return false;
+  }
+  return true;
+}
+
+// list the elements of [firstElement, firstElement+numElements) whose range of
+// the contour variable at the current time step is needed. Returns false,
+// with a single run covering all elements, when no culling can be done.
+bool vtkSalvusHDF5Reader::Select_Elements(long firstElement, long numElements, ElementRuns& runs)
+{
+  runs.clear();
+  const char* vname = this->Get_Contour_Variable();
+  if(!this->ElementRangesAvailable ||
+     !(this->ValueRangeFilter || this->OutputMode == CONTOUR_MODE))
+  {
+    runs.emplace_back(firstElement, numElements);
+    return false;
+  }
+
+  hsize_t count[3], offset[3];
+  std::vector<float> minmax(numElements * 2);
+  std::string cacheName = this->Get_Range_Cache_Name();
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+
+  hid_t cache_id = H5Fopen(cacheName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t group_id = H5Gopen(cache_id, model, H5P_DEFAULT);
+  hid_t ranges_id = H5Dopen(group_id, vname, H5P_DEFAULT);
+  count[0] = numElements * 2;
+  hid_t memspace = H5Screate_simple(1, count, NULL);
+  count[0] = 1;
+  count[1] = numElements;
+  count[2] = 2;
+  offset[0] = this->ActualTimeStep;
+  offset[1] = firstElement;
+  offset[2] = 0;
+  hid_t dataspace = H5Dget_space(ranges_id);
+  herr_t status = -1;
+  if(ranges_id >= 0 && H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL) >= 0)
+    status = H5Dread(ranges_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, minmax.data());
+  H5Sclose(dataspace);
+  H5Sclose(memspace);
+  H5Dclose(ranges_id);
+  H5Gclose(group_id);
+  H5Fclose(cache_id);
+
+  // never cull on ranges which could not be read
+  if(status < 0)
+  {
+    vtkWarningMacro(<< "cannot read the element ranges of " << vname << " in " << cacheName);
+    runs.emplace_back(firstElement, numElements);
+    return false;
+  }
+
+  for(long e = 0; e < numElements; e++)
+  {
+    if(this->Is_Element_Needed(minmax[2 * e], minmax[2 * e + 1]))
+    {
+      if(!runs.empty() && runs.back().first + runs.back().second == firstElement + e)
+        runs.back().second++;
+      else
+        runs.emplace_back(firstElement + e, 1);
+    }
+  }
+  return true;
+}
+
+// read the coordinates of the 8 corners of n elements, corner m being
+// GLL node 4*(m&1) + 20*((m>>1)&1) + 100*(m>>2)
+static void Read_Element_Corners(hid_t coords_id, long first, long n, float* corners)
+{
+  hsize_t count[3], offset[3], stride[3] = {1, 4, 1};
+  const hsize_t cornerBlocks[4] = {0, 20, 100, 120};
+
+  count[0] = n * 8 * 3;
+  hid_t memspace = H5Screate_simple(1, count, NULL);
+  hid_t dataspace = H5Dget_space(coords_id);
+  H5Sselect_none(dataspace);
+  for(int c = 0; c < 4; c++)
+  {
+    offset[0] = first;
+    offset[1] = cornerBlocks[c];
+    offset[2] = 0;
+    count[0] = n;
+    count[1] = 2;
+    count[2] = 3;
+    H5Sselect_hyperslab(dataspace, H5S_SELECT_OR, offset, stride, count, NULL);
+  }
+  H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, corners);
+  H5Sclose(dataspace);
+  H5Sclose(memspace);
+}
+
+// corners of a face among the 8 element corners
+static const int FaceCorners[6][4] = {{0, 2, 6, 4}, {1, 3, 7, 5}, {0, 1, 5, 4},
+                                      {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 5, 7, 6}};
+
+// GLL node (a, b) of face f of an element. Faces are i=0, i=4, j=0, j=4, k=0, k=4
+static int Face_Node(int f, int a, int b)
+{
+  switch(f)
+  {
+    case 0:  return 5*a + 25*b;
+    case 1:  return 4 + 5*a + 25*b;
+    case 2:  return a + 25*b;
+    case 3:  return a + 20 + 25*b;
+    case 4:  return a + 5*b;
+    default: return a + 5*b + 100;
+  }
+}
+
+// nodes are duplicated in every element, so faces shared by two elements are
+// found by their geometry: the bit patterns of their 4 corners, sorted so
+// that the key does not depend on the orientation of the element. The hash
+// only orders the faces, equal faces are the ones with equal keys.
+struct Face_Key
+{
+  unsigned long long Hash;
+  unsigned int Corners[4][3];
+  long long Face; // 6 * element + face
+
+  bool operator<(const Face_Key& other) const
+  {
+    if(this->Hash != other.Hash)
+      return this->Hash < other.Hash;
+    return memcmp(this->Corners, other.Corners, sizeof(this->Corners)) < 0;
+  }
+  bool Same_Face(const Face_Key& other) const
+  {
+    return this->Hash == other.Hash && !memcmp(this->Corners, other.Corners, sizeof(this->Corners));
+  }
+};
+
+static void Set_Face_Key(const float* corners, int f, long long face, Face_Key& key)
+{
+  for(int q = 0; q < 4; q++)
+  {
+    for(int d = 0; d < 3; d++)
+    {
+      float v = corners[FaceCorners[f][q] * 3 + d] + 0.0f; // no -0.0
+      memcpy(&key.Corners[q][d], &v, sizeof(v));
+    }
+  }
+  for(int q = 1; q < 4; q++)
+    for(int r = q; r > 0 && std::lexicographical_compare(key.Corners[r], key.Corners[r] + 3,
+                                                         key.Corners[r - 1], key.Corners[r - 1] + 3); r--)
+      std::swap(key.Corners[r], key.Corners[r - 1]);
+  key.Hash = 1469598103934665603ULL;
+  for(int q = 0; q < 4; q++)
+    for(int d = 0; d < 3; d++)
+      key.Hash = (key.Hash ^ key.Corners[q][d]) * 1099511628211ULL;
+  key.Face = face;
+}
+
+std::string vtkSalvusHDF5Reader::Get_Boundary_Cache_Name()
+{
+  return std::string(this->FileName) + ".boundary.h5";
+}
+
+// one pass over the 8 corners of every element. The exterior faces are the
+// ones found only once. The result, a sorted list of 6 * element + face, is
+// kept in this->BoundaryFaces and saved as dataset <model> of the cache file.
+int vtkSalvusHDF5Reader::Build_Boundary_Cache(const std::string& cacheName)
+{
+  hsize_t count[1];
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+  const long NbElements = this->NbNodes / 125;
+
+  hid_t f_id = H5Fopen(this->FileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t coords_id = H5Dopen(f_id, (this->ModelName == ELASTIC) ? "coordinates_ELASTIC" : "coordinates_ACOUSTIC", H5P_DEFAULT);
+
+  std::vector<Face_Key> faces;
+  faces.reserve(6 * NbElements);
+  std::vector<float> corners(static_cast<size_t>(this->BatchSize) * 8 * 3);
+  for(long first = 0; first < NbElements; first += this->BatchSize)
+  {
+    long n = std::min(static_cast<long>(this->BatchSize), NbElements - first);
+
+    Read_Element_Corners(coords_id, first, n, corners.data());
+
+    for(long e = 0; e < n; e++)
+    {
+      for(int f = 0; f < 6; f++)
+      {
+        faces.emplace_back();
+        Set_Face_Key(&corners[e * 8 * 3], f, (first + e) * 6 + f, faces.back());
+      }
+    }
+    this->UpdateProgress(0.5 * (first + n) / NbElements);
+  }
+  H5Dclose(coords_id);
+  H5Fclose(f_id);
+
+  std::sort(faces.begin(), faces.end());
+  this->BoundaryFaces.clear();
+  for(size_t i = 0; i < faces.size(); )
+  {
+    size_t j = i + 1;
+    while(j < faces.size() && faces[j].Same_Face(faces[i]))
+      j++;
+    if(j == i + 1)
+      this->BoundaryFaces.push_back(faces[i].Face);
+    i = j;
+  }
+  faces.clear();
+  faces.shrink_to_fit();
+  std::sort(this->BoundaryFaces.begin(), this->BoundaryFaces.end());
+
+  hid_t cache_id;
+  if(vtksys::SystemTools::FileExists(cacheName))
+    cache_id = H5Fopen(cacheName.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+  else
+    cache_id = H5Fcreate(cacheName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if(cache_id < 0)
+  {
+    vtkWarningMacro(<< "cannot write the boundary cache " << cacheName);
+    return 1;
+  }
+  if(H5Lexists(cache_id, model, H5P_DEFAULT) > 0)
+    H5Ldelete(cache_id, model, H5P_DEFAULT);
+  count[0] = this->BoundaryFaces.size();
+  hid_t dataspace = H5Screate_simple(1, count, NULL);
+  hid_t faces_id = H5Dcreate(cache_id, model, H5T_NATIVE_LLONG, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Dwrite(faces_id, H5T_NATIVE_LLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT, this->BoundaryFaces.data());
+  this->Set_Cache_Attributes(faces_id, BoundaryCacheVersion);
+  H5Dclose(faces_id);
+  H5Sclose(dataspace);
+  H5Fclose(cache_id);
+  return 1;
+}
+
+int vtkSalvusHDF5Reader::Update_Boundary_Cache()
+{
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+  std::string source = std::string(this->FileName) + ":" + model;
+  if(this->BoundaryFacesSource == source)
+    return 1;
+  this->BoundaryFaces.clear();
+  this->BoundaryFacesSource.clear();
+
+  // in parallel, the cache is built once, by the first process
+  std::string cacheName = this->Get_Boundary_Cache_Name();
+  vtkMultiProcessController* controller = vtkMultiProcessController::GetGlobalController();
+  int rank = controller ? controller->GetLocalProcessId() : 0;
+  bool built = false;
+  if(rank == 0 && !this->Is_Cache_Valid(cacheName, BoundaryCacheVersion))
+    built = this->Build_Boundary_Cache(cacheName);
+  if(controller && controller->GetNumberOfProcesses() > 1)
+    controller->Barrier();
+
+  if(!built)
+  {
+    if(this->Is_Cache_Valid(cacheName, BoundaryCacheVersion))
+    {
+      hid_t cache_id = H5Fopen(cacheName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      hid_t faces_id = H5Dopen(cache_id, model, H5P_DEFAULT);
+      hid_t dataspace = H5Dget_space(faces_id);
+      this->BoundaryFaces.resize(H5Sget_simple_extent_npoints(dataspace));
+      herr_t status = H5Dread(faces_id, H5T_NATIVE_LLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT, this->BoundaryFaces.data());
+      H5Sclose(dataspace);
+      H5Dclose(faces_id);
+      H5Fclose(cache_id);
+      if(status < 0)
+        this->Build_Boundary_Cache(cacheName);
+    }
+    else // the cache could not be written
+    {
+      this->Build_Boundary_Cache(cacheName);
+    }
+  }
+  this->BoundaryFacesSource = source;
+  return 1;
+}
+
+void vtkSalvusHDF5Reader::Select_Boundary_Elements(long firstElement, long numElements, ElementRuns& runs)
+{
+  runs.clear();
+  auto face = std::lower_bound(this->BoundaryFaces.begin(), this->BoundaryFaces.end(),
+                               static_cast<long long>(firstElement) * 6);
+  auto last = std::lower_bound(face, this->BoundaryFaces.end(),
+                               static_cast<long long>(firstElement + numElements) * 6);
+  for(; face != last; ++face)
+  {
+    long e = static_cast<long>(*face / 6);
+    if(!runs.empty() && runs.back().first + runs.back().second - 1 == e)
+      continue; // another face of the same element
+    if(!runs.empty() && runs.back().first + runs.back().second == e)
+      runs.back().second++;
+    else
+      runs.emplace_back(e, 1);
+  }
+}
+
+// each exterior face of the elements of the batch gives 25 points and 16 quads
+vtkSmartPointer<vtkPolyData> vtkSalvusHDF5Reader::Extract_Surface(vtkUnstructuredGrid* batch, const ElementRuns& runs)
+{
+  vtkSmartPointer<vtkPolyData> surface = vtkSmartPointer<vtkPolyData>::New();
+
+  long numFaces = 0;
+  for(const auto& run : runs)
+  {
+    numFaces += std::lower_bound(this->BoundaryFaces.begin(), this->BoundaryFaces.end(), static_cast<long long>(run.first + run.second) * 6) -
+                std::lower_bound(this->BoundaryFaces.begin(), this->BoundaryFaces.end(), static_cast<long long>(run.first) * 6);
+  }
+  if(numFaces == 0)
+    return surface;
+
+  vtkPointData* inPD = batch->GetPointData();
+  std::vector<float*> inArrays, outArrays;
+  std::vector<int> components;
+  for(int i = 0; i < inPD->GetNumberOfArrays(); i++)
+  {
+    vtkFloatArray* input = vtkFloatArray::SafeDownCast(inPD->GetArray(i));
+    vtkFloatArray* data = vtkFloatArray::New();
+    data->SetNumberOfComponents(input->GetNumberOfComponents());
+    data->SetNumberOfTuples(numFaces * 25);
+    data->SetName(input->GetName());
+    surface->GetPointData()->AddArray(data);
+    data->FastDelete();
+    inArrays.push_back(input->GetPointer(0));
+    outArrays.push_back(data->GetPointer(0));
+    components.push_back(input->GetNumberOfComponents());
+  }
+
+  vtkFloatArray *coords = vtkFloatArray::New();
+  coords->SetNumberOfComponents(3);
+  coords->SetNumberOfTuples(numFaces * 25);
+  const float* inCoords = vtkFloatArray::SafeDownCast(batch->GetPoints()->GetData())->GetPointer(0);
+  float* outCoords = coords->GetPointer(0);
+
+  vtkIdTypeArray *vtklistcells = vtkIdTypeArray::New();
+  vtklistcells->SetNumberOfValues(numFaces * 16 * (4 + 1));
+  vtkIdType *destptr = vtklistcells->GetPointer(0);
+
+  vtkIdType packedElement = 0, outPoint = 0;
+  for(const auto& run : runs)
+  {
+    for(long e = run.first; e < run.first + run.second; e++, packedElement++)
+    {
+      auto face = std::lower_bound(this->BoundaryFaces.begin(), this->BoundaryFaces.end(), static_cast<long long>(e) * 6);
+      for(; face != this->BoundaryFaces.end() && *face < static_cast<long long>(e + 1) * 6; ++face)
+      {
+        const int f = static_cast<int>(*face % 6);
+        for(int b = 0; b < 5; b++)
+        {
+          for(int a = 0; a < 5; a++)
+          {
+            const vtkIdType src = packedElement * 125 + Face_Node(f, a, b);
+            const vtkIdType dst = outPoint + a + 5 * b;
+            for(int d = 0; d < 3; d++)
+              outCoords[3 * dst + d] = inCoords[3 * src + d];
+            for(size_t i = 0; i < inArrays.size(); i++)
+              for(int c = 0; c < components[i]; c++)
+                outArrays[i][components[i] * dst + c] = inArrays[i][components[i] * src + c];
+          }
+        }
+        for(int b = 0; b < 4; b++)
+        {
+          for(int a = 0; a < 4; a++)
+          {
+            *destptr++ = 4;
+            *destptr++ = outPoint + a     + 5 * b;
+            *destptr++ = outPoint + a + 1 + 5 * b;
+            *destptr++ = outPoint + a + 1 + 5 * (b + 1);
+            *destptr++ = outPoint + a     + 5 * (b + 1);
+          }
+        }
+        outPoint += 25;
+      }
+    }
+  }
+
+  vtkPoints *points = vtkPoints::New();
+  points->SetData(coords);
+  coords->FastDelete();
+  surface->SetPoints(points);
+  points->FastDelete();
+
+  vtkCellArray *quads = vtkCellArray::New();
+  quads->SetCells(numFaces * 16, vtklistcells);
+  vtklistcells->FastDelete();
+  surface->SetPolys(quads);
+  quads->FastDelete();
+  return surface;
+}
+
+// bounding boxes of the elements from their 8 corners, enlarged by a quarter
+// of their size on each side since elements may be curved, then binned in a
+// uniform grid of about 2 elements per bin
+void vtkSalvusHDF5Reader::Build_Element_Index(long int coords_dset)
+{
+  hid_t coords_id = static_cast<hid_t>(coords_dset);
+  const long NbElements = this->NbNodes / 125;
+
+  this->ElementBounds.resize(6 * NbElements);
+  double bounds[6] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN};
+  std::vector<float> corners(static_cast<size_t>(this->BatchSize) * 8 * 3);
+  for(long first = 0; first < NbElements; first += this->BatchSize)
+  {
+    long n = std::min(static_cast<long>(this->BatchSize), NbElements - first);
+    Read_Element_Corners(coords_id, first, n, corners.data());
+    for(long e = 0; e < n; e++)
+    {
+      float* box = &this->ElementBounds[6 * (first + e)];
+      for(int d = 0; d < 3; d++)
+      {
+        box[2 * d] = box[2 * d + 1] = corners[e * 24 + d];
+        for(int m = 1; m < 8; m++)
+        {
+          box[2 * d] = std::min(box[2 * d], corners[(e * 8 + m) * 3 + d]);
+          box[2 * d + 1] = std::max(box[2 * d + 1], corners[(e * 8 + m) * 3 + d]);
+        }
+        float margin = 0.25f * (box[2 * d + 1] - box[2 * d]);
+        box[2 * d] -= margin;
+        box[2 * d + 1] += margin;
+        bounds[2 * d] = std::min(bounds[2 * d], static_cast<double>(box[2 * d]));
+        bounds[2 * d + 1] = std::max(bounds[2 * d + 1], static_cast<double>(box[2 * d + 1]));
+      }
+    }
+  }
+
+  int dim = std::max(1, static_cast<int>(std::cbrt(NbElements / 2.0)));
+  for(int d = 0; d < 3; d++)
+  {
+    this->BinDims[d] = dim;
+    this->BinOrigin[d] = bounds[2 * d];
+    this->BinSpacing[d] = (bounds[2 * d + 1] - bounds[2 * d]) / dim;
+    if(this->BinSpacing[d] <= 0.0)
+      this->BinSpacing[d] = 1.0;
+  }
+
+  // two passes over the elements, to count then to fill the bins
+  const long NbBins = static_cast<long>(dim) * dim * dim;
+  this->BinOffsets.assign(NbBins + 1, 0);
+  for(int pass = 0; pass < 2; pass++)
+  {
+    std::vector<long> fill;
+    if(pass == 1)
+    {
+      for(long b = 0; b < NbBins; b++)
+        this->BinOffsets[b + 1] += this->BinOffsets[b];
+      this->BinElements.resize(this->BinOffsets[NbBins]);
+      fill.assign(this->BinOffsets.begin(), this->BinOffsets.end() - 1);
+    }
+    for(long e = 0; e < NbElements; e++)
+    {
+      const float* box = &this->ElementBounds[6 * e];
+      int lo[3], hi[3];
+      for(int d = 0; d < 3; d++)
+      {
+        lo[d] = std::min(dim - 1, std::max(0, static_cast<int>((box[2 * d] - this->BinOrigin[d]) / this->BinSpacing[d])));
+        hi[d] = std::min(dim - 1, std::max(0, static_cast<int>((box[2 * d + 1] - this->BinOrigin[d]) / this->BinSpacing[d])));
+      }
+      for(int k = lo[2]; k <= hi[2]; k++)
+        for(int j = lo[1]; j <= hi[1]; j++)
+          for(int i = lo[0]; i <= hi[0]; i++)
+          {
+            long b = i + static_cast<long>(dim) * (j + static_cast<long>(dim) * k);
+            if(pass == 0)
+              this->BinOffsets[b + 1]++;
+            else
+              this->BinElements[fill[b]++] = e;
+          }
+    }
+  }
+}
+
+// returns the element containing p and the reference coordinates of p in it, or -1
+long vtkSalvusHDF5Reader::Locate_Element(long int coords_dset, const double p[3], double xi[3])
+{
+  hid_t coords_id = static_cast<hid_t>(coords_dset);
+  hsize_t count[3], offset[3];
+  int bin[3];
+  for(int d = 0; d < 3; d++)
+  {
+    double x = (p[d] - this->BinOrigin[d]) / this->BinSpacing[d];
+    if(x < 0.0 || x > this->BinDims[d])
+      return -1;
+    bin[d] = std::min(this->BinDims[d] - 1, static_cast<int>(x));
+  }
+  long b = bin[0] + static_cast<long>(this->BinDims[0]) * (bin[1] + static_cast<long>(this->BinDims[1]) * bin[2]);
+
+  float coords[125 * 3];
+  count[0] = 125 * 3;
+  hid_t memspace = H5Screate_simple(1, count, NULL);
+  hid_t dataspace = H5Dget_space(coords_id);
+  long found = -1;
+  for(long c = this->BinOffsets[b]; c < this->BinOffsets[b + 1] && found < 0; c++)
+  {
+    long e = this->BinElements[c];
+    const float* box = &this->ElementBounds[6 * e];
+    if(p[0] < box[0] || p[0] > box[1] || p[1] < box[2] || p[1] > box[3] || p[2] < box[4] || p[2] > box[5])
+      continue;
+    count[0] = 1;
+    count[1] = 125;
+    count[2] = 3;
+    offset[0] = e;
+    offset[1] = 0;
+    offset[2] = 0;
+    H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+    H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, coords);
+    if(SalvusGLL::FindReferenceCoordinates(coords, p, xi))
+      found = e;
+  }
+  H5Sclose(dataspace);
+  H5Sclose(memspace);
+  return found;
+}
+
+// time series of the enabled variables at the probe points. For each point,
+// the 125 GLL values of its element are read for all time steps in a single
+// hyperslab, and interpolated with the GLL basis.
+int vtkSalvusHDF5Reader::Extract_Probes(vtkTable* output, const int piece)
+{
+  // the table is small, it is produced by the first piece only
+  if(piece != 0)
+    return 1;
+
+  hid_t root_id, coords_id, volume_id, data_id;
+  hsize_t count[4], offset[4];
+  file_id = H5Fopen(this->FileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+  root_id = H5Gopen(file_id, "/", H5P_DEFAULT);
+  volume_id = H5Gopen(root_id, "volume", H5P_DEFAULT);
+  if(this->ModelName == ELASTIC)
+  {
+    coords_id = H5Dopen(root_id, "coordinates_ELASTIC", H5P_DEFAULT);
+    data_id   = H5Dopen(volume_id, "stress", H5P_DEFAULT);
+  }
+  else
+  {
+    coords_id = H5Dopen(root_id, "coordinates_ACOUSTIC", H5P_DEFAULT);
+    data_id   = H5Dopen(volume_id, "phi_tt", H5P_DEFAULT);
+  }
+
+  const char* model = (this->ModelName == ELASTIC) ? "ELASTIC" : "ACOUSTIC";
+  std::string source = std::string(this->FileName) + ":" + model;
+  if(this->ElementIndexSource != source)
+  {
+    this->Build_Element_Index(coords_id);
+    this->ElementIndexSource = source;
+  }
+
+  vtkDoubleArray* time = vtkDoubleArray::New();
+  time->SetName("Time");
+  time->SetNumberOfTuples(this->NumberOfTimeSteps);
+  for(int t = 0; t < this->NumberOfTimeSteps; t++)
+    time->SetValue(t, this->TimeStepValues[t]);
+  output->AddColumn(time);
+  time->FastDelete();
+
+  const std::vector<std::string>& vars = this->varnames[this->ModelName];
+  const int NbComponents = static_cast<int>(vars.size());
+  const int NbProbes = this->GetNumberOfProbePoints();
+  std::vector<float> values(static_cast<size_t>(this->NumberOfTimeSteps) * NbComponents * 125);
+  double N[125], dN[125][3];
+  for(int p = 0; p < NbProbes; p++)
+  {
+    double xi[3];
+    long e = this->Locate_Element(coords_id, &this->ProbePoints[3 * p], xi);
+    if(e < 0)
+    {
+      vtkWarningMacro(<< "probe point " << p << " (" << this->ProbePoints[3 * p] << ", "
+                      << this->ProbePoints[3 * p + 1] << ", " << this->ProbePoints[3 * p + 2]
+                      << ") is outside of the mesh");
+    }
+    else
+    {
+      count[0] = values.size();
+      hid_t memspace = H5Screate_simple(1, count, NULL);
+      count[0] = this->NumberOfTimeSteps;
+      count[1] = 1;
+      count[2] = NbComponents;
+      count[3] = 125;
+      offset[0] = 0;
+      offset[1] = e;
+      offset[2] = 0;
+      offset[3] = 0;
+      hid_t dataspace = H5Dget_space(data_id);
+      H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+      H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, values.data());
+      H5Sclose(dataspace);
+      H5Sclose(memspace);
+      SalvusGLL::ShapeFunctions(xi, N, dN);
+    }
+
+    for(int i = 0; i < NbComponents; i++)
+    {
+      if(!this->Is_Variable_Enabled(vars[i].c_str()))
+        continue;
+      std::ostringstream name;
+      name << vars[i] << "_" << p;
+      vtkDoubleArray* series = vtkDoubleArray::New();
+      series->SetName(name.str().c_str());
+      series->SetNumberOfTuples(this->NumberOfTimeSteps);
+      for(int t = 0; t < this->NumberOfTimeSteps; t++)
+      {
+        double value = vtkMath::Nan();
+        if(e >= 0)
+        {
+          const float* v = &values[(static_cast<size_t>(t) * NbComponents + i) * 125];
+          value = 0.0;
+          for(int n = 0; n < 125; n++)
+            value += N[n] * v[n];
+        }
+        series->SetValue(t, value);
+      }
+      output->AddColumn(series);
+      series->FastDelete();
+    }
+  }
+
+  H5Dclose(data_id);
+  H5Dclose(coords_id);
+  H5Gclose(volume_id);
+  H5Gclose(root_id);
+  H5Fclose(file_id);
+  return 1;
+}
+
+void vtkSalvusHDF5Reader::AddProbePoint(double x, double y, double z)
+{
+  this->ProbePoints.push_back(x);
+  this->ProbePoints.push_back(y);
+  this->ProbePoints.push_back(z);
+  this->Modified();
+}
+
+void vtkSalvusHDF5Reader::RemoveAllProbePoints()
+{
+  if(!this->ProbePoints.empty())
+  {
+    this->ProbePoints.clear();
+    this->Modified();
+  }
+}
+
+int vtkSalvusHDF5Reader::GetNumberOfProbePoints()
+{
+  return static_cast<int>(this->ProbePoints.size() / 3);
+}
+
+void vtkSalvusHDF5Reader::SetContourValue(int i, double value)
+{
+  if(i < 0)
+    return;
+  if(i >= static_cast<int>(this->ContourValues.size()))
+    this->ContourValues.resize(i + 1, 0.0);
+  if(this->ContourValues[i] != value)
+  {
+    this->ContourValues[i] = value;
+    this->Modified();
+  }
+}
+
+double vtkSalvusHDF5Reader::GetContourValue(int i)
+{
+  if(i < 0 || i >= static_cast<int>(this->ContourValues.size()))
+    return 0.0;
+  return this->ContourValues[i];
+}
+
+void vtkSalvusHDF5Reader::SetNumberOfContours(int number)
+{
+  if(number >= 0 && number != static_cast<int>(this->ContourValues.size()))
+  {
+    this->ContourValues.resize(number, 0.0);
+    this->Modified();
+  }
+}
+
+int vtkSalvusHDF5Reader::GetNumberOfContours()
+{
+  return static_cast<int>(this->ContourValues.size());
 }
 
 void vtkSalvusHDF5Reader::EnablePointArray(const char* name)
@@ -9,7 +9,9 @@
 
 #include "SalvusHDF5ReaderModule.h" // for export macro
 #include "vtkUnstructuredGridAlgorithm.h"
+#include "vtkSmartPointer.h" // for batch readers
 
+#include <map>
 #include <vector>
 #include <string>
 
@@ -17,7 +19,27 @@
 #define ELASTIC 0
 #define ACOUSTIC 1
 
+// OutputMode: VOLUME_MODE produces the full vtkUnstructuredGrid, the other
+// modes stream the mesh in batches of elements and only produce vtkPolyData.
+// SURFACE_MODE only reads the elements on the boundary of the model, and
+// outputs the quadrilaterals of their exterior faces. PROBE_MODE produces a
+// vtkTable with the time series of the enabled variables at ProbePoints.
+//
+// Files converted by SalvusVizConverter (see vtkSalvusVizLayout.h) are
+// detected and read natively, in VOLUME_MODE only.
+//
+// The 125 GLL nodes of an element are expected to form a 5x5x5 tensor-product
+// lattice, node i + 5*j + 25*k. Which reference axis is i, j or k does not matter.
+#define VOLUME_MODE 0
+#define CONTOUR_MODE 1
+#define SLICE_MODE 2
+#define SURFACE_MODE 3
+#define PROBE_MODE 4
+
 class vtkDataArraySelection;
+class vtkPointData;
+class vtkPolyData;
+class vtkTable;
 
 class SALVUSHDF5READER_EXPORT vtkSalvusHDF5Reader : public vtkUnstructuredGridAlgorithm
 {
@@ -34,6 +56,82 @@ public:
   vtkGetMacro(NbCells,int);
   vtkGetMacro(NbNodes,int);
 
+  vtkSetMacro(OutputMode, int);
+  vtkGetMacro(OutputMode, int);
+
+  // number of spectral elements (125 GLL nodes each) read per batch in the
+  // streamed modes. Peak memory is about two batches.
+  vtkSetClampMacro(BatchSize, int, 1, VTK_INT_MAX);
+  vtkGetMacro(BatchSize, int);
+
+  // isovalues used in CONTOUR_MODE, applied to ContourArray. ContourArray
+  // defaults to the first variable of the current model, and is read even
+  // if it is not enabled.
+  vtkSetStringMacro(ContourArray);
+  vtkGetStringMacro(ContourArray);
+  void SetContourValue(int i, double value);
+  double GetContourValue(int i);
+  void SetNumberOfContours(int number);
+  int GetNumberOfContours();
+
+  // plane used in SLICE_MODE
+  vtkSetVector3Macro(SliceOrigin, double);
+  vtkGetVector3Macro(SliceOrigin, double);
+  vtkSetVector3Macro(SliceNormal, double);
+  vtkGetVector3Macro(SliceNormal, double);
+
+  // per-element, per-time step min/max of every variable of the current
+  // model, computed once and saved in RangeCacheFileName (defaults to
+  // FileName + ".ranges.h5"). When available, the data ranges are given in
+  // RequestInformation, and CONTOUR_MODE skips the elements which cannot
+  // contain any of the isovalues.
+  vtkSetMacro(UseElementRanges, int);
+  vtkGetMacro(UseElementRanges, int);
+  vtkBooleanMacro(UseElementRanges, int);
+
+  vtkSetStringMacro(RangeCacheFileName);
+  vtkGetStringMacro(RangeCacheFileName);
+
+  // only read the elements whose range of ContourArray intersects
+  // ValueRange. Implies UseElementRanges.
+  vtkSetMacro(ValueRangeFilter, int);
+  vtkGetMacro(ValueRangeFilter, int);
+  vtkBooleanMacro(ValueRangeFilter, int);
+  vtkSetVector2Macro(ValueRange, double);
+  vtkGetVector2Macro(ValueRange, double);
+
+  // points where PROBE_MODE evaluates the enabled variables at all time
+  // steps, with the GLL basis of the element containing each point
+  void AddProbePoint(double x, double y, double z);
+  void RemoveAllProbePoints();
+  int GetNumberOfProbePoints();
+
+  // add the gradient grad_<name> of every enabled point array, computed per
+  // element with the GLL differentiation matrix, and div_stress when the six
+  // stress components are enabled. Like the probes and the surface mode, this
+  // is disabled if the element nodes are not in the GLL tensor order
+  vtkSetMacro(ComputeGradients, int);
+  vtkGetMacro(ComputeGradients, int);
+  vtkBooleanMacro(ComputeGradients, int);
+
+  // in parallel VOLUME_MODE, the processes running on the same node share a
+  // single copy of the coordinates and connectivity, read by the first
+  // process of the node into an MPI-3 shared-memory window. The geometry is
+  // kept across time steps, only the variables are read again. Used only when
+  // every process reads the piece of its rank, a private copy is read otherwise.
+  vtkSetMacro(UseSharedMemoryGeometry, int);
+  vtkGetMacro(UseSharedMemoryGeometry, int);
+  vtkBooleanMacro(UseSharedMemoryGeometry, int);
+
+  // range of a point array at a given time step index, or over all time
+  // steps if timeStep < 0. Returns 0 if the range is not known.
+  int GetPointArrayRange(const char* name, int timeStep, double range[2]);
+
+  // ranges of the contour variable known from the range cache, at the time
+  // step of the last update and over all time steps. min > max if unknown.
+  vtkGetVector2Macro(ContourArrayRange, double);
+  vtkGetVector2Macro(ContourArrayGlobalRange, double);
+
   vtkGetObjectMacro(ELASTIC_PointDataArraySelection, vtkDataArraySelection);
   vtkGetObjectMacro(ACOUSTIC_PointDataArraySelection, vtkDataArraySelection);
 
@@ -59,6 +157,13 @@ protected:
   vtkSalvusHDF5Reader();
   ~vtkSalvusHDF5Reader();
 
+  vtkTypeBool ProcessRequest(vtkInformation*,
+                             vtkInformationVector**,
+                             vtkInformationVector*) override;
+  int FillOutputPortInformation(int, vtkInformation*) override;
+  int RequestDataObject(vtkInformation*,
+                        vtkInformationVector**,
+                        vtkInformationVector*);
   int RequestData(vtkInformation*,
                   vtkInformationVector**,
                   vtkInformationVector*);
@@ -75,6 +180,41 @@ protected:
   int NbCells;
   bool Is_Variable_Enabled(const char* vname);
   void Load_Variables(vtkUnstructuredGrid* output, const int numPieces, const int, const int, long int data_id);
+  const char* Get_Contour_Variable();
+  void Update_Contour_Array_Ranges();
+  void Get_Piece_Elements(const int piece, const int numPieces, long& firstElement, long& numElements);
+
+  // lists of {firstElement, numElements}
+  typedef std::vector<std::pair<long, long>> ElementRuns;
+  vtkSmartPointer<vtkUnstructuredGrid> Read_Element_Runs(long int mesh_id, long int coords_id, long int data_id,
+                                                         const ElementRuns& runs, bool readCells = true);
+
+  std::string Get_Range_Cache_Name();
+  bool Is_Cache_Valid(const std::string& cacheName, int version);
+  void Set_Cache_Attributes(long int object_id, int version);
+  bool Check_Cache_Attributes(long int object_id, int version);
+  int Build_Range_Cache(const std::string& cacheName);
+  int Update_Range_Cache();
+  bool Is_Element_Needed(float minValue, float maxValue);
+  bool Select_Elements(long firstElement, long numElements, ElementRuns& runs);
+
+  std::string Get_Boundary_Cache_Name();
+  int Build_Boundary_Cache(const std::string& cacheName);
+  int Update_Boundary_Cache();
+  void Select_Boundary_Elements(long firstElement, long numElements, ElementRuns& runs);
+  vtkSmartPointer<vtkPolyData> Extract_Surface(vtkUnstructuredGrid* batch, const ElementRuns& runs);
+
+  bool Check_GLL_Node_Ordering(long int mesh_id);
+  void Build_Element_Index(long int coords_id);
+  long Locate_Element(long int coords_id, const double p[3], double xi[3]);
+  int Extract_Probes(vtkTable* output, const int piece);
+  void Compute_Gradients(vtkPointData* pd, const float* coords, long numElements);
+  int Load_Shared_Geometry(vtkUnstructuredGrid* output, long int mesh_id, long int coords_id,
+                           long firstElement, long numElements);
+  void Release_Shared_Geometry();
+  int Read_Viz_Layout(vtkUnstructuredGrid* output, const int piece, const int numPieces);
+  vtkSmartPointer<vtkPolyData> Extract_Batch(vtkUnstructuredGrid* batch, const ElementRuns& runs);
+  int Extract_Streamed(vtkPolyData* output, const int piece, const int numPieces);
   
  private:
   vtkSalvusHDF5Reader(const vtkSalvusHDF5Reader&) = delete;
@@ -82,6 +222,38 @@ protected:
   
   std::vector<std::string> varnames[2];
   int ModelName; // 0 = ELASTIC, 1 = ACOUSTIC
+  int OutputMode; // 0 = VOLUME_MODE, 1 = CONTOUR_MODE, 2 = SLICE_MODE, 3 = SURFACE_MODE, 4 = PROBE_MODE
+  int BatchSize;
+  int CellsPerElement; // number of 8-node hexahedra per spectral element
+  std::vector<double> ContourValues;
+  char *ContourArray;
+  double SliceOrigin[3];
+  double SliceNormal[3];
+  int UseElementRanges;
+  int ValueRangeFilter;
+  double ValueRange[2];
+  double ContourArrayRange[2];
+  double ContourArrayGlobalRange[2];
+  char *RangeCacheFileName;
+  bool ElementRangesAvailable;
+  bool VizLayout; // the file was written by SalvusVizConverter
+  bool GLLNodeOrdering; // node i + 5*j + 25*k of an element is GLL node (i, j, k)
+  std::map<std::string, std::vector<double>> StepRanges; // {min, max} per time step
+  std::vector<long long> BoundaryFaces; // sorted 6 * element + face
+  std::string BoundaryFacesSource; // file and model BoundaryFaces were loaded for
+  std::vector<double> ProbePoints;
+  int ComputeGradients;
+  int UseSharedMemoryGeometry;
+  struct vtkSalvusSharedGeometry; // MPI window and the VTK views of it
+  vtkSalvusSharedGeometry* SharedGeometry;
+  // spatial index of the elements: bounding boxes and uniform bins
+  std::vector<float> ElementBounds; // xmin, xmax, ymin, ymax, zmin, zmax
+  int BinDims[3];
+  double BinOrigin[3];
+  double BinSpacing[3];
+  std::vector<long> BinOffsets;
+  std::vector<long> BinElements;
+  std::string ElementIndexSource; // file and model the index was built for
   std::vector<double> TimeStepValues;
   int NumberOfTimeSteps;
   int TimeStep;
@@ -0,0 +1,47 @@
+/*=========================================================================
+// .NAME vtkSalvusVizLayout - layout of the visualization Salvus files
+// .SECTION Description
+// Written once by SalvusVizConverter from a solver file, and read natively
+// by vtkSalvusHDF5Reader. The root attribute salvus_viz_layout holds the
+// version. For each MODEL (ELASTIC, ACOUSTIC):
+//   /coordinates_MODEL {nNodes, 3} float, the nodes shared by several
+//                       elements are stored once, with the average of
+//                       the values of these elements
+//   /connectivity_MODEL {nCells, 8} int64, the hexahedra of the elements,
+//                       the elements being sorted along a Morton curve
+//   /volume/MODEL/<var> {T, nNodes} float, chunked by (1 time step, node block)
+// The nodes are numbered in the order of the sorted elements, so that a
+// block of elements uses a compact block of nodes.
+// /volume keeps the time attributes of the solver file.
+*/
+#ifndef __vtkSalvusVizLayout_h
+#define __vtkSalvusVizLayout_h
+
+#include <string>
+
+namespace SalvusVizLayout
+{
+static const char* const Attribute = "salvus_viz_layout";
+static const int Version = 1;
+
+// the dataset of a variable
+inline std::string Field(const char* model, const char* var)
+{
+  return std::string("/volume/") + model + "/" + var;
+}
+
+// interleave the bits of three 21-bit integers
+inline unsigned long long MortonKey(unsigned int x, unsigned int y, unsigned int z)
+{
+  unsigned long long key = 0;
+  for(int b = 0; b < 21; b++)
+  {
+    key |= static_cast<unsigned long long>((x >> b) & 1) << (3 * b);
+    key |= static_cast<unsigned long long>((y >> b) & 1) << (3 * b + 1);
+    key |= static_cast<unsigned long long>((z >> b) & 1) << (3 * b + 2);
+  }
+  return key;
+}
+} // namespace SalvusVizLayout
+
+#endif
@@ -4,8 +4,11 @@
 //#include "vtkDataSetWriter.h"
 #include "vtkSalvusHDF5Reader.h"
 #include "vtkInformation.h"
+#include "vtkMPIController.h"
 #include "vtkNew.h"
 #include "vtkPointData.h"
+#include "vtkPolyData.h"
+#include "vtkTable.h"
 #include "vtkUnstructuredGrid.h"
 
 #include <vtksys/SystemTools.hxx>
@@ -16,6 +19,10 @@ vtkIOSalvusCxxTests(int argc, char **argv)
 {
   std::string filein;
   std::string varname;
+  double contourValue = 0.0;
+  bool contour = false;
+  std::vector<double> probe;
+  bool shared = false;
 
   double TimeStep = 4.2898e-05;
 
@@ -25,6 +32,14 @@ vtkIOSalvusCxxTests(int argc, char **argv)
     "-f", vtksys::CommandLineArguments::SPACE_ARGUMENT, &filein, "(the names of the Gadget (HDF5) files to read)");
   args.AddArgument(
     "-var", vtksys::CommandLineArguments::SPACE_ARGUMENT, &varname, "(the name of the SCALAR variable to display)");
+  args.AddArgument(
+    "-contour", vtksys::CommandLineArguments::SPACE_ARGUMENT, &contourValue, "(isovalue of stress_xx, extracted in the streamed contour mode)");
+  args.AddBooleanArgument(
+    "-stream", &contour, "(use the streamed contour mode instead of reading the volume)");
+  args.AddArgument(
+    "-probe", vtksys::CommandLineArguments::MULTI_ARGUMENT, &probe, "(x y z of a point where to extract the time series of stress_xx)");
+  args.AddBooleanArgument(
+    "-shared", &shared, "(run under mpirun, every process reads one piece, sharing the geometry within the node)");
 
   if ( !args.Parse() || argc == 1 || filein.empty())
     {
@@ -50,13 +65,48 @@ vtkIOSalvusCxxTests(int argc, char **argv)
     cout << "found array (" << i << ") = " << reader->GetPointArrayName(i) << endl;
   reader->DisableAllPointArrays();
   reader->SetPointArrayStatus("stress_xx", 1);
+  if(contour)
+    {
+    reader->SetOutputMode(CONTOUR_MODE);
+    reader->SetContourArray("stress_xx");
+    reader->SetContourValue(0, contourValue);
+    }
+  else if(probe.size() == 3)
+    {
+    reader->SetOutputMode(PROBE_MODE);
+    reader->AddProbePoint(probe[0], probe[1], probe[2]);
+    }
 
-  reader->UpdateTimeStep(TimeStep); // time value
-  reader->Update();
+  vtkMultiProcessController* controller = vtkMultiProcessController::GetGlobalController();
+  if(shared)
+    {
+    reader->SetUseSharedMemoryGeometry(1);
+    reader->UpdateTimeStep(TimeStep, controller->GetLocalProcessId(), controller->GetNumberOfProcesses());
+    cerr << "piece " << controller->GetLocalProcessId() << ": "
+         << reader->GetOutput()->GetNumberOfPoints() << " points, "
+         << reader->GetOutput()->GetNumberOfCells() << " cells\n";
+    }
+  else
+    {
+    reader->UpdateTimeStep(TimeStep); // time value
+    reader->Update();
+    }
 
   double range[2];
-      
-  if(varname.size())
+
+  if(contour)
+    {
+    vtkPolyData *iso = vtkPolyData::SafeDownCast(reader->GetOutputDataObject(0));
+    cerr << "streamed contour: " << iso->GetNumberOfPoints() << " points, "
+         << iso->GetNumberOfCells() << " cells\n";
+    }
+  else if(probe.size() == 3)
+    {
+    vtkTable *series = vtkTable::SafeDownCast(reader->GetOutputDataObject(0));
+    for(auto t=0; t < series->GetNumberOfRows(); t++)
+      cout << series->GetValue(t, 0) << " " << series->GetValue(t, 1) << endl;
+    }
+  else if(varname.size())
     {
     reader->GetOutput()->GetPointData()->GetArray(0)->GetRange(range);
     cerr << varname.c_str() << ": scalar range = [" << range[0] << ", " << range[1] << "]\n";
@@ -76,6 +126,11 @@ vtkIOSalvusCxxTests(int argc, char **argv)
 int
 main(int argc, char **argv)
 {
-  vtkIOSalvusCxxTests(argc, argv);
+  vtkNew<vtkMPIController> controller;
+  controller->Initialize(&argc, &argv);
+  vtkMultiProcessController::SetGlobalController(controller);
+  int ret = vtkIOSalvusCxxTests(argc, argv);
+  controller->Finalize();
+  return ret;
 }
 
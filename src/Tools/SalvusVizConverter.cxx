@@ -0,0 +1,460 @@
+// SalvusVizConverter: rewrite a Salvus solver file in the visualization
+// layout described in vtkSalvusVizLayout.h.
+//
+// The solver file stores the 125 GLL nodes of every element, the fields
+// being padded to 128 values per element and interleaved by component:
+//   /volume/stress {T, nElem, 6, 128}, /volume/phi_tt {T, nElem, 1, 128}
+// so reading one component at one time step strides through the whole
+// dataset. The converted file sorts the elements along a Morton curve,
+// stores every node once, drops the padding, and writes one dataset per
+// variable, chunked by (time step, node block).
+//
+// Nodes are merged when their coordinates are bitwise identical. The
+// solution is only continuous in the displacement: the stress, and phi_tt
+// on curved elements, jump across every element face. A merged node takes
+// the average of the values of the elements which share it.
+//
+// The coordinates, the connectivity and the fields are read by blocks of
+// elements, but the node merging is done in memory. For the whole mesh, the
+// converter holds the new id of every GLL node (1000 bytes per element), the
+// hash map of the distinct nodes, and their coordinates, weights and values
+// at one time step: about 6 KB per element with about 64 distinct nodes per
+// element, i.e. 35 GB for 5.7 million elements (364 million hexahedra).
+
+#include "vtkSalvusVizLayout.h"
+
+#include <hdf5.h>
+#include <vtksys/CommandLineArguments.hxx>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using std::cerr;
+
+static const char* const Models[2] = {"ELASTIC", "ACOUSTIC"};
+// solver dataset and component names of every model
+static const char* const Fields[2] = {"stress", "phi_tt"};
+static const std::vector<std::string> Variables[2] = {
+  {"stress_xx", "stress_yy", "stress_zz", "stress_yz", "stress_xz", "stress_xy"},
+  {"phi_tt"}};
+
+struct NodeKey
+{
+  unsigned int x, y, z;
+  bool operator==(const NodeKey& other) const
+  {
+    return x == other.x && y == other.y && z == other.z;
+  }
+};
+
+struct NodeKeyHash
+{
+  size_t operator()(const NodeKey& k) const
+  {
+    unsigned long long h = k.x;
+    h = h * 0x9E3779B97F4A7C15ULL + k.y;
+    h = h * 0x9E3779B97F4A7C15ULL + k.z;
+    return static_cast<size_t>(h ^ (h >> 29));
+  }
+};
+
+static NodeKey Node_Key(const float* p)
+{
+  NodeKey k;
+  memcpy(&k.x, &p[0], sizeof(float));
+  memcpy(&k.y, &p[1], sizeof(float));
+  memcpy(&k.z, &p[2], sizeof(float));
+  return k;
+}
+
+// creation properties of a chunked, optionally compressed, 2D dataset
+static hid_t Chunked_Property(hsize_t rows, hsize_t columns, int deflate)
+{
+  hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+  hsize_t chunk[2] = {std::max<hsize_t>(rows, 1), std::max<hsize_t>(columns, 1)};
+  H5Pset_chunk(plist, 2, chunk);
+  if(deflate > 0)
+  {
+    H5Pset_shuffle(plist);
+    H5Pset_deflate(plist, deflate);
+  }
+  return plist;
+}
+
+static void Copy_Attribute(hid_t from, hid_t to, const char* name)
+{
+  double value;
+  if(H5Aexists(from, name) <= 0)
+    return;
+  hid_t attr = H5Aopen(from, name, H5P_DEFAULT);
+  H5Aread(attr, H5T_NATIVE_DOUBLE, &value);
+  H5Aclose(attr);
+  hid_t space = H5Screate(H5S_SCALAR);
+  attr = H5Acreate(to, name, H5T_IEEE_F64LE, space, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attr, H5T_NATIVE_DOUBLE, &value);
+  H5Aclose(attr);
+  H5Sclose(space);
+}
+
+// read the elements order[first] to order[first + n - 1] of a dataset whose
+// first dimension is rowsPerElement times the element. HDF5 returns them in
+// file order, slot[k] is the position in buffer of element order[first + k].
+static herr_t Read_Sorted_Elements(hid_t dset_id, hid_t memType, const std::vector<long>& order, long first,
+                                   long n, hsize_t rowsPerElement, void* buffer, std::vector<long>& slot)
+{
+  std::vector<std::pair<long, long>> elements; // element, position in the block
+  for(long k = 0; k < n; k++)
+    elements.emplace_back(order[first + k], k);
+  std::sort(elements.begin(), elements.end());
+  slot.resize(n);
+  for(long j = 0; j < n; j++)
+    slot[elements[j].second] = j;
+
+  hid_t space = H5Dget_space(dset_id);
+  const int rank = H5Sget_simple_extent_ndims(space);
+  hsize_t dims[3], offset[3] = {0, 0, 0}, count[3];
+  H5Sget_simple_extent_dims(space, dims, NULL);
+  hsize_t elementSize = rowsPerElement;
+  for(int d = 1; d < rank; d++)
+  {
+    count[d] = dims[d];
+    elementSize *= dims[d];
+  }
+  H5Sselect_none(space);
+  for(size_t j = 0; j < elements.size();)
+  {
+    // runs of consecutive elements
+    size_t last = j;
+    while(last + 1 < elements.size() && elements[last + 1].first == elements[last].first + 1)
+      last++;
+    offset[0] = elements[j].first * rowsPerElement;
+    count[0] = (last - j + 1) * rowsPerElement;
+    H5Sselect_hyperslab(space, H5S_SELECT_OR, offset, NULL, count, NULL);
+    j = last + 1;
+  }
+  hsize_t memsize = n * elementSize;
+  hid_t memspace = H5Screate_simple(1, &memsize, NULL);
+  herr_t status = H5Dread(dset_id, memType, memspace, space, H5P_DEFAULT, buffer);
+  H5Sclose(memspace);
+  H5Sclose(space);
+  return status;
+}
+
+// the elements sorted along a Morton curve through their centroids, the
+// coordinates being read by blocks of elements
+static std::vector<long> Morton_Order(hid_t coords_id, long NbElements, int blockSize)
+{
+  std::vector<double> centroids(3 * NbElements, 0.0);
+  std::vector<float> coords(375 * static_cast<size_t>(blockSize));
+  double bounds[6] = {1e300, -1e300, 1e300, -1e300, 1e300, -1e300};
+  hid_t space = H5Dget_space(coords_id);
+  for(long first = 0; first < NbElements; first += blockSize)
+  {
+    const long n = std::min<long>(blockSize, NbElements - first);
+    hsize_t count[3] = {static_cast<hsize_t>(n), 125, 3}, offset[3] = {static_cast<hsize_t>(first), 0, 0};
+    hsize_t memsize = 375 * n;
+    hid_t memspace = H5Screate_simple(1, &memsize, NULL);
+    H5Sselect_hyperslab(space, H5S_SELECT_SET, offset, NULL, count, NULL);
+    H5Dread(coords_id, H5T_NATIVE_FLOAT, memspace, space, H5P_DEFAULT, coords.data());
+    H5Sclose(memspace);
+    for(long e = first; e < first + n; e++)
+    {
+      for(int node = 0; node < 125; node++)
+        for(int d = 0; d < 3; d++)
+          centroids[3 * e + d] += coords[375 * (e - first) + 3 * node + d] / 125.0;
+      for(int d = 0; d < 3; d++)
+      {
+        bounds[2 * d] = std::min(bounds[2 * d], centroids[3 * e + d]);
+        bounds[2 * d + 1] = std::max(bounds[2 * d + 1], centroids[3 * e + d]);
+      }
+    }
+  }
+  H5Sclose(space);
+
+  const double maxKey = (1 << 21) - 1;
+  std::vector<unsigned long long> keys(NbElements);
+  for(long e = 0; e < NbElements; e++)
+  {
+    unsigned int q[3];
+    for(int d = 0; d < 3; d++)
+    {
+      double extent = bounds[2 * d + 1] - bounds[2 * d];
+      double t = (extent > 0.0) ? (centroids[3 * e + d] - bounds[2 * d]) / extent : 0.0;
+      q[d] = static_cast<unsigned int>(t * maxKey);
+    }
+    keys[e] = SalvusVizLayout::MortonKey(q[0], q[1], q[2]);
+  }
+
+  std::vector<long> order(NbElements);
+  std::iota(order.begin(), order.end(), 0L);
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](long a, long b) { return keys[a] < keys[b]; });
+  return order;
+}
+
+static int Convert_Model(hid_t in_id, hid_t out_id, int model, hsize_t chunkNodes, int deflate, int blockSize)
+{
+  const char* name = Models[model];
+  std::string coordsName = std::string("coordinates_") + name;
+  std::string meshName = std::string("connectivity_") + name;
+  std::string fieldName = std::string("/volume/") + Fields[model];
+  if(H5Lexists(in_id, coordsName.c_str(), H5P_DEFAULT) <= 0)
+    return 1;
+
+  hsize_t dimsf[4];
+  hid_t coords_id = H5Dopen(in_id, coordsName.c_str(), H5P_DEFAULT);
+  hid_t space = H5Dget_space(coords_id);
+  H5Sget_simple_extent_dims(space, dimsf, NULL);
+  H5Sclose(space);
+  const long NbElements = dimsf[0];
+
+  hid_t mesh_id = H5Dopen(in_id, meshName.c_str(), H5P_DEFAULT);
+  hid_t meshspace = H5Dget_space(mesh_id);
+  H5Sget_simple_extent_dims(meshspace, dimsf, NULL);
+  H5Sclose(meshspace);
+  const long NbCells = dimsf[0];
+  const long CellsPerElement = NbElements ? NbCells / NbElements : 0;
+
+  cerr << name << ": " << NbElements << " elements, " << NbCells << " hexahedra\n";
+
+  // new node ids, in the order of first use by the sorted elements, and the
+  // number of elements sharing every node
+  std::vector<long> order = Morton_Order(coords_id, NbElements, blockSize);
+  std::vector<long long> newId(125 * NbElements);
+  std::vector<float> nodes;
+  std::vector<float> weights;
+  std::vector<long> slot;
+  {
+    std::vector<float> coords(375 * static_cast<size_t>(blockSize));
+    std::unordered_map<NodeKey, long long, NodeKeyHash> ids;
+    for(long first = 0; first < NbElements; first += blockSize)
+    {
+      const long n = std::min<long>(blockSize, NbElements - first);
+      if(Read_Sorted_Elements(coords_id, H5T_NATIVE_FLOAT, order, first, n, 1, coords.data(), slot) < 0)
+      {
+        cerr << "error reading " << coordsName << "\n";
+        return 0;
+      }
+      for(long k = 0; k < n; k++)
+      {
+        const long e = order[first + k];
+        for(int node = 0; node < 125; node++)
+        {
+          const float* p = &coords[375 * slot[k] + 3 * node];
+          auto inserted = ids.emplace(Node_Key(p), static_cast<long long>(weights.size()));
+          if(inserted.second)
+          {
+            nodes.insert(nodes.end(), p, p + 3);
+            weights.push_back(0.0f);
+          }
+          newId[125 * e + node] = inserted.first->second;
+          weights[inserted.first->second] += 1.0f;
+        }
+      }
+    }
+  }
+  H5Dclose(coords_id);
+  const hsize_t NbNodes = weights.size();
+  for(float& w : weights)
+    w = 1.0f / w;
+  cerr << name << ": " << 125 * NbElements << " nodes merged into " << NbNodes << "\n";
+
+  dimsf[0] = NbNodes;
+  dimsf[1] = 3;
+  space = H5Screate_simple(2, dimsf, NULL);
+  hid_t plist = Chunked_Property(std::min(NbNodes, chunkNodes), 3, deflate);
+  coords_id = H5Dcreate(out_id, coordsName.c_str(), H5T_IEEE_F32LE, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+  H5Dwrite(coords_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, nodes.data());
+  H5Dclose(coords_id);
+  H5Pclose(plist);
+  H5Sclose(space);
+
+  // the connectivity, by blocks of sorted elements. The hexahedra of sorted
+  // element k are the ones of element order[k], read in file order
+  dimsf[0] = NbCells;
+  dimsf[1] = 8;
+  space = H5Screate_simple(2, dimsf, NULL);
+  plist = Chunked_Property(std::min<hsize_t>(NbCells, chunkNodes), 8, deflate);
+  hid_t out_mesh_id = H5Dcreate(out_id, meshName.c_str(), H5T_STD_I64LE, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+  H5Pclose(plist);
+  const long ElementSize = 8 * CellsPerElement;
+  std::vector<long long> cells(ElementSize * static_cast<size_t>(blockSize));
+  std::vector<long long> sortedCells(cells.size());
+  for(long first = 0; first < NbElements; first += blockSize)
+  {
+    const long n = std::min<long>(blockSize, NbElements - first);
+    if(Read_Sorted_Elements(mesh_id, H5T_NATIVE_LLONG, order, first, n, CellsPerElement, cells.data(), slot) < 0)
+    {
+      cerr << "error reading " << meshName << "\n";
+      return 0;
+    }
+    for(long k = 0; k < n; k++)
+    {
+      const long long* from = &cells[slot[k] * ElementSize];
+      long long* to = &sortedCells[k * ElementSize];
+      for(long c = 0; c < ElementSize; c++)
+        to[c] = newId[from[c]];
+    }
+
+    hsize_t offset[2] = {static_cast<hsize_t>(first * CellsPerElement), 0};
+    hsize_t count[2] = {static_cast<hsize_t>(n * CellsPerElement), 8};
+    hsize_t memsize = n * ElementSize;
+    hid_t memspace = H5Screate_simple(1, &memsize, NULL);
+    H5Sselect_hyperslab(space, H5S_SELECT_SET, offset, NULL, count, NULL);
+    H5Dwrite(out_mesh_id, H5T_NATIVE_LLONG, memspace, space, H5P_DEFAULT, sortedCells.data());
+    H5Sclose(memspace);
+  }
+  H5Dclose(out_mesh_id);
+  H5Sclose(space);
+  H5Dclose(mesh_id);
+  cells.clear();
+  cells.shrink_to_fit();
+  sortedCells.clear();
+  sortedCells.shrink_to_fit();
+
+  if(H5Lexists(in_id, fieldName.c_str(), H5P_DEFAULT) <= 0)
+    return 1;
+
+  // the fields, one time step and one component at a time, read by blocks of elements
+  hid_t data_id = H5Dopen(in_id, fieldName.c_str(), H5P_DEFAULT);
+  hid_t dataspace = H5Dget_space(data_id);
+  H5Sget_simple_extent_dims(dataspace, dimsf, NULL);
+  const hsize_t NbTimeSteps = dimsf[0];
+  hid_t group_id = H5Gcreate(out_id, (std::string("/volume/") + name).c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(group_id);
+
+  std::vector<float> row(NbNodes), block(125 * static_cast<size_t>(blockSize));
+  hsize_t count[4], offset[4], fdims[2] = {NbTimeSteps, NbNodes};
+  for(size_t i = 0; i < Variables[model].size(); i++)
+  {
+    const std::string varName = SalvusVizLayout::Field(name, Variables[model][i].c_str());
+    space = H5Screate_simple(2, fdims, NULL);
+    plist = Chunked_Property(1, std::min(NbNodes, chunkNodes), deflate);
+    hid_t var_id = H5Dcreate(out_id, varName.c_str(), H5T_IEEE_F32LE, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+    H5Pclose(plist);
+
+    for(hsize_t t = 0; t < NbTimeSteps; t++)
+    {
+      std::fill(row.begin(), row.end(), 0.0f);
+      for(long first = 0; first < NbElements; first += blockSize)
+      {
+        const long n = std::min<long>(blockSize, NbElements - first);
+        count[0] = 1;
+        count[1] = n;
+        count[2] = 1;
+        count[3] = 125;
+        offset[0] = t;
+        offset[1] = first;
+        offset[2] = i;
+        offset[3] = 0;
+        hsize_t memsize = n * 125;
+        hid_t memspace = H5Screate_simple(1, &memsize, NULL);
+        H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+        if(H5Dread(data_id, H5T_NATIVE_FLOAT, memspace, dataspace, H5P_DEFAULT, block.data()) < 0)
+        {
+          cerr << "error reading " << fieldName << " at time step " << t << "\n";
+          return 0;
+        }
+        H5Sclose(memspace);
+        for(long j = 0; j < n * 125; j++)
+          row[newId[125 * first + j]] += block[j];
+      }
+      for(hsize_t node = 0; node < NbNodes; node++)
+        row[node] *= weights[node];
+
+      hsize_t rowCount[2] = {1, NbNodes}, rowOffset[2] = {t, 0};
+      hid_t memspace = H5Screate_simple(1, &NbNodes, NULL);
+      H5Sselect_hyperslab(space, H5S_SELECT_SET, rowOffset, NULL, rowCount, NULL);
+      H5Dwrite(var_id, H5T_NATIVE_FLOAT, memspace, space, H5P_DEFAULT, row.data());
+      H5Sclose(memspace);
+    }
+    H5Dclose(var_id);
+    H5Sclose(space);
+    cerr << varName << ": " << NbTimeSteps << " time steps\n";
+  }
+  H5Sclose(dataspace);
+  H5Dclose(data_id);
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  std::string filein, fileout;
+  int chunkNodes = 65536;
+  int deflate = 0;
+  int blockSize = 4096;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument(
+    "-f", vtksys::CommandLineArguments::SPACE_ARGUMENT, &filein, "(the Salvus file written by the solver)");
+  args.AddArgument(
+    "-o", vtksys::CommandLineArguments::SPACE_ARGUMENT, &fileout, "(the converted file)");
+  args.AddArgument(
+    "-chunk", vtksys::CommandLineArguments::SPACE_ARGUMENT, &chunkNodes, "(number of nodes per chunk, default 65536)");
+  args.AddArgument(
+    "-deflate", vtksys::CommandLineArguments::SPACE_ARGUMENT, &deflate, "(gzip level 1-9, default 0: no compression)");
+  args.AddArgument(
+    "-block", vtksys::CommandLineArguments::SPACE_ARGUMENT, &blockSize, "(number of elements read at once, default 4096)");
+
+  if(!args.Parse() || argc == 1 || filein.empty() || fileout.empty() || chunkNodes < 1 || blockSize < 1)
+  {
+    cerr << "\nSalvusVizConverter: rewrite a Salvus file for visualization\n"
+         << "the nodes are merged in memory, which needs about 6 KB per element\n"
+         << "options are:\n";
+    cerr << args.GetHelp() << "\n";
+    return EXIT_FAILURE;
+  }
+  if(!vtksys::SystemTools::FileExists(filein.c_str()))
+  {
+    cerr << "\nFile " << filein.c_str() << " does not exist\n\n";
+    return EXIT_FAILURE;
+  }
+
+  hid_t in_id = H5Fopen(filein.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  if(in_id < 0 || H5Lexists(in_id, "/volume", H5P_DEFAULT) <= 0)
+  {
+    cerr << filein << " is not a Salvus file\n";
+    return EXIT_FAILURE;
+  }
+  if(H5Aexists(in_id, SalvusVizLayout::Attribute) > 0)
+  {
+    cerr << filein << " is already converted\n";
+    return EXIT_FAILURE;
+  }
+  hid_t out_id = H5Fcreate(fileout.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if(out_id < 0)
+  {
+    cerr << "cannot create " << fileout << "\n";
+    return EXIT_FAILURE;
+  }
+
+  hid_t volume_in = H5Gopen(in_id, "/volume", H5P_DEFAULT);
+  hid_t volume_out = H5Gcreate(out_id, "/volume", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  Copy_Attribute(volume_in, volume_out, "sampling_rate_in_hertz");
+  Copy_Attribute(volume_in, volume_out, "start_time_in_seconds");
+  H5Gclose(volume_out);
+  H5Gclose(volume_in);
+
+  int ok = 1;
+  for(int model = 0; model < 2 && ok; model++)
+    ok = Convert_Model(in_id, out_id, model, chunkNodes, deflate, blockSize);
+
+  // written last, an interrupted conversion is not mistaken for a valid file
+  if(ok)
+  {
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate(out_id, SalvusVizLayout::Attribute, H5T_STD_I32LE, space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, H5T_NATIVE_INT, &SalvusVizLayout::Version);
+    H5Aclose(attr);
+    H5Sclose(space);
+  }
+  H5Fclose(out_id);
+  H5Fclose(in_id);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}